@@ -0,0 +1,134 @@
+/**************************************************************
+ *
+ * This sketch downloads the same file over 1 and over several
+ * connections at once, and compares the durations.
+ *
+ * TinyGSM Getting Started guide:
+ *   http://tiny.cc/tiny-gsm-readme
+ *
+ * ATTENTION! Segmented downloads need one mux per connection
+ * and a modem that buffers received data (CIPRXGET, QIRD, USORD),
+ * so use a board with enough RAM and a fast serial link.
+ *
+ **************************************************************/
+
+// Select your modem:
+#define TINY_GSM_MODEM_SIM800
+// #define TINY_GSM_MODEM_SIM808
+// #define TINY_GSM_MODEM_UBLOX
+// #define TINY_GSM_MODEM_BG96
+
+// Every client keeps its own RX buffer and the downloader one more,
+// so keep them small on boards with little RAM
+#if defined(__AVR__)
+  #define DOWNLOAD_BUFFER 128
+#else
+  #define DOWNLOAD_BUFFER 1024
+#endif
+
+#define TINY_GSM_RX_BUFFER   DOWNLOAD_BUFFER
+#define TINY_GSM_HTTP_BUFFER DOWNLOAD_BUFFER
+
+#include <TinyGsmClient.h>
+#include <TinyGsmDownloader.h>
+
+// Set serial for debug console (to the Serial Monitor, default speed 115200)
+#define SerialMon Serial
+
+// Use Hardware Serial on Mega, Leonardo, Micro
+#define SerialAT Serial1
+
+// Your GPRS credentials
+// Leave empty, if missing user or pass
+const char apn[]  = "YourAPN";
+const char user[] = "";
+const char pass[] = "";
+
+// Server details
+const char server[] = "vsh.pp.ua";
+const int  port = 80;
+
+const char resource[]  = "/TinyGSM/test_1m.bin";
+uint32_t knownCRC32    = 0xbe74c743;
+
+// Connections used for the segmented run (1 + extra streams)
+#define STREAMS 3
+
+TinyGsm modem(SerialAT);
+
+TinyGsmClient client0(modem, 0);
+TinyGsmClient client1(modem, 1);
+TinyGsmClient client2(modem, 2);
+
+TinyGsmClient* clients[STREAMS] = { &client0, &client1, &client2 };
+
+bool discard(uint32_t offset, const uint8_t* data, size_t len, void* arg) {
+  // Write to flash / SD here
+  return true;
+}
+
+void run(uint8_t streams) {
+  TinyGsmDownloader dl(*clients[0], server, port);
+  for (uint8_t i = 1; i < streams; i++) {
+    dl.addStream(*clients[i]);
+  }
+
+  SerialMon.print(F("Downloading over "));
+  SerialMon.print(streams);
+  SerialMon.print(F(" connection(s)..."));
+
+  uint32_t start = millis();
+  bool ok = dl.download(resource, discard);
+  float duration = float(millis() - start) / 1000;
+
+  SerialMon.println(ok ? " OK" : " fail");
+  SerialMon.print("Size:           ");   SerialMon.println(dl.offset());
+  SerialMon.print("Calc. CRC32:    0x"); SerialMon.println(dl.crc32(), HEX);
+  SerialMon.print("Known CRC32:    0x"); SerialMon.println(knownCRC32, HEX);
+  SerialMon.print("Duration:       ");   SerialMon.print(duration); SerialMon.println("s");
+  SerialMon.print("Speed:          ");   SerialMon.print(dl.offset() / duration / 1024); SerialMon.println(" KB/s");
+  SerialMon.println();
+}
+
+void setup() {
+  // Set console baud rate
+  SerialMon.begin(115200);
+  delay(10);
+
+  // Set GSM module baud rate
+  SerialAT.begin(115200);
+  delay(3000);
+
+  SerialMon.println(F("Initializing modem..."));
+  modem.restart();
+}
+
+void loop() {
+  SerialMon.print(F("Waiting for network..."));
+  if (!modem.waitForNetwork()) {
+    SerialMon.println(" fail");
+    delay(10000);
+    return;
+  }
+  SerialMon.println(" OK");
+
+  SerialMon.print(F("Connecting to "));
+  SerialMon.print(apn);
+  if (!modem.gprsConnect(apn, user, pass)) {
+    SerialMon.println(" fail");
+    delay(10000);
+    return;
+  }
+  SerialMon.println(" OK");
+
+  run(1);
+  run(STREAMS);
+
+  modem.gprsDisconnect();
+  SerialMon.println(F("GPRS disconnected"));
+
+  // Do nothing forevermore
+  while (true) {
+    delay(1000);
+  }
+}
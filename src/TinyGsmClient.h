@@ -26,6 +26,8 @@
 #ifndef TINY_GSM_NO_GPRS
   typedef TinyGsmSim800::GsmClient TinyGsmClient;
   typedef TinyGsmSim800::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim800::GsmUdp TinyGsmClientUdp;
+  typedef TinyGsmSim800::GsmServer TinyGsmServer;
 #endif // TINY_GSM_NO_GPRS
 
 #elif defined(TINY_GSM_MODEM_SIM808) || defined(TINY_GSM_MODEM_SIM868)
@@ -34,6 +36,8 @@
   typedef TinyGsmSim808 TinyGsm;
   typedef TinyGsmSim808::GsmClient TinyGsmClient;
   typedef TinyGsmSim808::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim808::GsmUdp TinyGsmClientUdp;
+  typedef TinyGsmSim808::GsmServer TinyGsmServer;
 
 #elif defined(TINY_GSM_MODEM_UBLOX)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -41,12 +45,16 @@
   typedef TinyGsmUBLOX TinyGsm;
   typedef TinyGsmUBLOX::GsmClient TinyGsmClient;
   typedef TinyGsmUBLOX::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmUBLOX::GsmUdp TinyGsmClientUdp;
+  typedef TinyGsmUBLOX::GsmServer TinyGsmServer;
 
 #elif defined(TINY_GSM_MODEM_BG96)
   #define TINY_GSM_MODEM_HAS_GPRS
   #include <TinyGsmClientBG96.h>
   typedef TinyGsmBG96 TinyGsm;
   typedef TinyGsmBG96::GsmClient TinyGsmClient;
+  typedef TinyGsmBG96::GsmUdp TinyGsmClientUdp;
+  typedef TinyGsmBG96::GsmServer TinyGsmServer;
 
 #elif defined(TINY_GSM_MODEM_A6) || defined(TINY_GSM_MODEM_A7)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -66,6 +74,7 @@
   typedef TinyGsmESP8266 TinyGsm;
   typedef TinyGsmESP8266::GsmClient TinyGsmClient;
   typedef TinyGsmESP8266::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmESP8266::GsmServer TinyGsmServer;
 
 #elif defined(TINY_GSM_MODEM_XBEE)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -125,6 +125,12 @@ public:
     return write((const uint8_t *)str, strlen(str));
   }
 
+  virtual size_t writev(const TinyGsmSegment* segs, size_t count) {
+    TINY_GSM_YIELD();
+    //at->maintain();
+    return at->modemSendv(segs, count, mux);
+  }
+
   virtual int available() {
     TINY_GSM_YIELD();
     if (!rx.size() && sock_connected) {
@@ -655,16 +661,22 @@ protected:
   }
 
   int modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+CIPSEND="), mux, ',', len);
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  int modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    sendAT(GF("+CIPSEND="), mux, ',', total);
     if (waitResponse(2000L, GF(GSM_NL ">")) != 1) {
       return 0;
     }
-    stream.write((uint8_t*)buff, len);
+    TinyGsmWriteSegments(stream, segs, count);
     stream.flush();
     if (waitResponse(10000L, GFP(GSM_OK), GF(GSM_NL "FAIL")) != 1) {
       return 0;
     }
-    return len;
+    return total;
   }
 
   bool modemGetConnected(uint8_t mux) {
@@ -18,7 +18,12 @@
 
 #define TINY_GSM_MUX_COUNT 12
 
+// Largest single QISEND
+#define TINY_GSM_SEND_MAX 1460
+
 #include <TinyGsmCommon.h>
+#include <TinyGsmMqtt.h>
+#include <TinyGsmUdp.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -74,6 +79,7 @@ public:
     this->mux = mux;
     sock_available = 0;
     sock_connected = false;
+    sock_connecting = false;
     got_data = false;
 
     at->sockets[mux] = this;
@@ -102,14 +108,46 @@ public:
     return connect(host.c_str(), port);
   }
 
+  // Starts connecting and returns as soon as the modem accepts the request.
+  // Completion arrives as a "+QIOPEN: <mux>,<err>" URC, so several
+  // sockets can be opened in parallel; poll connecting() until it clears.
+  virtual int connectAsync(const char *host, uint16_t port) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_connecting = at->modemConnectAsync(host, port, mux);
+    return sock_connecting;
+  }
+
+  bool connecting() {
+    if (sock_connecting) {
+      at->maintain();
+    }
+    return sock_connecting;
+  }
+
   virtual void stop() {
     TINY_GSM_YIELD();
     at->sendAT(GF("+QICLOSE="), mux);
     sock_connected = false;
+    sock_connecting = false;
     at->waitResponse();
     rx.clear();
   }
 
+  // Closes with a 1s FIN timeout instead of the default 10s.
+  // Anything the modem still holds for this socket is dropped.
+  virtual void abort() {
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_available = 0;
+    got_data = false;
+    at->sendAT(GF("+QICLOSE="), mux, GF(",1"));
+    sock_connected = false;
+    sock_connecting = false;
+    at->waitResponse(2000L);
+  }
+
   virtual size_t write(const uint8_t *buf, size_t size) {
     TINY_GSM_YIELD();
     at->maintain();
@@ -125,6 +163,8 @@ public:
     return write((const uint8_t *)str, strlen(str));
   }
 
+TINY_GSM_CLIENT_WRITEV()
+
   virtual int available() {
     TINY_GSM_YIELD();
     if (!rx.size()) {
@@ -186,6 +226,7 @@ private:
   uint8_t       mux;
   uint16_t      sock_available;
   bool          sock_connected;
+  bool          sock_connecting;
   bool          got_data;
   RxFifo        rx;
 };
@@ -216,6 +257,453 @@ public:
   }
 };
 
+//============================================================================//
+//============================================================================//
+//                          The BG96 TCP Listener
+//============================================================================//
+//============================================================================//
+
+/*
+ * TCP server on a "TCP LISTENER" socket. Every incoming connection gets
+ * a free connect ID, reported by the "incoming" URC; accept() binds the
+ * next one to a GsmClient, which is then used like a connected one.
+ */
+class GsmServer
+{
+  friend class TinyGsmBG96;
+
+public:
+  GsmServer() {}
+
+  GsmServer(TinyGsmBG96& modem, uint8_t mux = TINY_GSM_MUX_COUNT - 1) {
+    init(&modem, mux);
+  }
+
+  virtual ~GsmServer() {}
+
+  bool init(TinyGsmBG96* modem, uint8_t mux = TINY_GSM_MUX_COUNT - 1) {
+    this->at = modem;
+    this->mux = mux;
+    pending = 0;
+    listening = false;
+    return true;
+  }
+
+  bool begin(uint16_t port) {
+    stop();
+    at->server_session = this;
+    listening = at->modemListen(port, mux);
+    return listening;
+  }
+
+  // Binds the oldest waiting connection to client.
+  // Returns false if nobody has connected meanwhile.
+  bool accept(GsmClient& client) {
+    at->maintain();
+    for (uint8_t id = 0; id < TINY_GSM_MUX_COUNT; id++) {
+      if (pending & (1 << id)) {
+        pending &= ~(1 << id);
+        client.init(at, id);
+        client.sock_connected = true;
+        // Data may have been announced before the client existed
+        client.got_data = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Stops listening, accepted connections stay open
+  void stop() {
+    if (listening) {
+      at->sendAT(GF("+QICLOSE="), mux);
+      at->waitResponse();
+    }
+    listening = false;
+    pending = 0;
+    if (at->server_session == this) {
+      at->server_session = NULL;
+    }
+  }
+
+  operator bool() {
+    return listening;
+  }
+
+private:
+  TinyGsmBG96*  at;
+  uint8_t       mux;
+  uint16_t      pending;
+  bool          listening;
+};
+
+//============================================================================//
+//============================================================================//
+//                          The BG96 UDP Service
+//============================================================================//
+//============================================================================//
+
+/*
+ * UDP on a "UDP SERVICE" socket, which can talk to any peer. Every
+ * endPacket() is one QISEND with the destination, and every parsePacket()
+ * one QIRD, which returns a single datagram along with the sender.
+ * The mux (2 by default) must not be one a GsmClient was created on.
+ */
+class GsmUdp : public TinyGsmUdp
+{
+  friend class TinyGsmBG96;
+
+public:
+  GsmUdp() {}
+
+  GsmUdp(TinyGsmBG96& modem, uint8_t mux = 2) {
+    init(&modem, mux);
+  }
+
+  virtual ~GsmUdp() {}
+
+  bool init(TinyGsmBG96* modem, uint8_t mux = 2) {
+    this->at = modem;
+    this->mux = mux;
+    sock_opened = false;
+    got_data = false;
+
+    if (!muxFree()) {
+      return false;
+    }
+    at->udps[mux] = this;
+
+    return true;
+  }
+
+  // Opens the service bound to the given local port (0 for any)
+  virtual uint8_t begin(uint16_t port) {
+    stop();
+    local_port = port;
+    if (!muxFree()) {
+      return 0;
+    }
+    sock_opened = at->modemOpenUdp(port, mux);
+    return sock_opened;
+  }
+
+  virtual void stop() {
+    if (sock_opened) {
+      TINY_GSM_YIELD();
+      at->sendAT(GF("+QICLOSE="), mux);
+      at->waitResponse();
+    }
+    sock_opened = false;
+    got_data = false;
+    rx_len = rx_pos = 0;
+  }
+
+protected:
+  virtual bool modemSendTo(const char* host, uint16_t port,
+                           const uint8_t* buf, size_t len) {
+    if (!sock_opened && !begin(local_port)) {
+      return false;
+    }
+    return at->modemSendTo(host, port, buf, len, mux) == (int)len;
+  }
+
+  virtual size_t modemReceive(uint8_t* buf, size_t len) {
+    if (!sock_opened) {
+      return 0;
+    }
+    if (!got_data) {
+      at->maintain();
+    }
+    if (!got_data) {
+      return 0;
+    }
+    String ip;
+    size_t n = at->modemReadFrom(buf, len, mux, ip, remote_port);
+    if (n) {
+      parseIp(ip, remote_ip);
+    } else {
+      // "recv" is only reported again once the buffer was drained
+      got_data = false;
+    }
+    return n;
+  }
+
+  // GsmClient and GsmUdp share the muxes, one can't take the other's
+  bool muxFree() {
+    if (at->sockets[mux]) {
+      DBG("### UDP mux", mux, "is used by a client");
+      return false;
+    }
+    return true;
+  }
+
+private:
+  TinyGsmBG96*  at;
+  uint8_t       mux;
+  bool          sock_opened;
+  bool          got_data;
+};
+
+//============================================================================//
+//============================================================================//
+//                          The BG96 UFS File
+//============================================================================//
+//============================================================================//
+
+/*
+ * A file in the modem's flash (UFS), e.g. one fetched by httpGetToFile().
+ * Reads go over the UART in blocks of the caller's buffer size, at any
+ * offset, so an interrupted transfer to the MCU can pick up where it left.
+ */
+class UfsFile
+{
+public:
+  UfsFile() {}
+
+  UfsFile(TinyGsmBG96& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmBG96* modem) {
+    this->at = modem;
+    handle = -1;
+    pos = 0;
+    return true;
+  }
+
+  // mode: 0 - open or create, 1 - create or truncate, 2 - read only
+  bool open(const char* filename, uint8_t mode = 2) {
+    close();
+    at->sendAT(GF("+QFOPEN=\"UFS:"), filename, GF("\","), mode);
+    if (at->waitResponse(GF(GSM_NL "+QFOPEN:")) != 1) {
+      return false;
+    }
+    handle = at->stream.readStringUntil('\n').toInt();
+    at->waitResponse();
+    pos = 0;
+    return true;
+  }
+
+  bool isOpen() {
+    return handle >= 0;
+  }
+
+  bool seek(uint32_t offset) {
+    if (handle < 0) {
+      return false;
+    }
+    at->sendAT(GF("+QFSEEK="), handle, ',', offset, GF(",0"));
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    pos = offset;
+    return true;
+  }
+
+  uint32_t position() {
+    return pos;
+  }
+
+  // Returns the number of bytes read, 0 at the end of file, -1 on error
+  int read(uint8_t* buf, size_t len) {
+    if (handle < 0) {
+      return -1;
+    }
+    at->sendAT(GF("+QFREAD="), handle, ',', (uint32_t)len);
+    if (at->waitResponse(5000L, GF("CONNECT ")) != 1) {
+      return -1;
+    }
+    size_t n = at->stream.readStringUntil('\n').toInt();
+    n = at->stream.readBytes(buf, TinyGsmMin(n, len));
+    at->waitResponse();
+    pos += n;
+    return n;
+  }
+
+  int read(uint8_t* buf, size_t len, uint32_t offset) {
+    if (offset != pos && !seek(offset)) {
+      return -1;
+    }
+    return read(buf, len);
+  }
+
+  void close() {
+    if (handle >= 0) {
+      at->sendAT(GF("+QFCLOSE="), handle);
+      at->waitResponse();
+      handle = -1;
+    }
+  }
+
+private:
+  TinyGsmBG96*  at;
+  int32_t       handle;
+  uint32_t      pos;
+};
+
+//============================================================================//
+//============================================================================//
+//                          The BG96 MQTT Client
+//============================================================================//
+//============================================================================//
+
+// Uses MQTT client index 0 of the modem (AT+QMT*)
+class Mqtt : public TinyGsmMqtt
+{
+  friend class TinyGsmBG96;
+
+public:
+  Mqtt() {}
+
+  Mqtt(TinyGsmBG96& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmBG96* modem) {
+    this->at = modem;
+    is_connected = false;
+    pub_pending = 0;
+    pub_failed = false;
+    msg_id = 0;
+    close_reason = 0;
+    at->mqtt_session = this;
+    return true;
+  }
+
+  using TinyGsmMqtt::publish;
+
+  virtual bool connect(const char* host, uint16_t port, const char* clientId,
+                       const char* user = NULL, const char* pass = NULL)
+  {
+    if (is_connected) {
+      disconnect();
+    }
+    close_reason = 0;
+    at->sendAT(GF("+QMTCFG=\"keepalive\",0,"), keepalive_s);
+    at->waitResponse();
+    at->sendAT(GF("+QMTCFG=\"recv/mode\",0,0,1"));  // Put the length in +QMTRECV
+    at->waitResponse();
+
+    at->sendAT(GF("+QMTOPEN=0,\""), host, GF("\","), port);
+    if (at->waitResponse() != 1 ||
+        at->waitResponse(75000L, GF(GSM_NL "+QMTOPEN:")) != 1) {
+      return false;
+    }
+    at->streamSkipUntil(',');  // Skip client index
+    if (at->stream.readStringUntil('\n').toInt() != 0) {
+      return false;
+    }
+
+    if (user) {
+      at->sendAT(GF("+QMTCONN=0,\""), clientId, GF("\",\""), user, GF("\",\""),
+                 pass ? pass : "", '"');
+    } else {
+      at->sendAT(GF("+QMTCONN=0,\""), clientId, '"');
+    }
+    // +QMTCONN: 0,<result>[,<return code>]
+    if (at->waitResponse() == 1 &&
+        at->waitResponse(60000L, GF(GSM_NL "+QMTCONN:")) == 1) {
+      at->streamSkipUntil(',');  // Skip client index
+      String res = at->stream.readStringUntil('\n');
+      int coma = res.indexOf(',');
+      is_connected = res.toInt() == 0 && (coma < 0 || res.substring(coma + 1).toInt() == 0);
+    }
+    if (!is_connected) {
+      at->sendAT(GF("+QMTCLOSE=0"));
+      at->waitResponse();
+    }
+    pub_pending = 0;
+    pub_failed = false;
+    return is_connected;
+  }
+
+  virtual void disconnect() {
+    at->sendAT(GF("+QMTDISC=0"));
+    if (at->waitResponse() == 1) {
+      at->waitResponse(30000L, GF(GSM_NL "+QMTDISC:"));
+      at->streamSkipUntil('\n');
+    }
+    is_connected = false;
+  }
+
+  virtual bool connected() {
+    return is_connected;
+  }
+
+  // +QMTSTAT code of the last lost connection (e.g. 1 = closed by peer,
+  // 2 = ping timeout), 0 if none since connect()
+  int closeReason() {
+    return close_reason;
+  }
+
+  virtual bool publish(const char* topic, const void* payload, size_t len,
+                       uint8_t qos = 0, bool retain = false)
+  {
+    at->sendAT(GF("+QMTPUB=0,"), qos ? nextId() : 0, ',', qos, ',', retain,
+               GF(",\""), topic, GF("\","), (uint16_t)len);
+    if (at->waitResponse(GF(">")) != 1) {
+      return false;
+    }
+    at->stream.write((const uint8_t*)payload, len);
+    at->stream.flush();
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    // Completion comes later as +QMTPUB, collected by flush()
+    pub_pending++;
+    return true;
+  }
+
+  virtual bool flush(uint32_t timeout_ms = 10000L) {
+    uint32_t startMillis = millis();
+    while (pub_pending && millis() - startMillis < timeout_ms) {
+      at->waitResponse(100, NULL, NULL);
+    }
+    bool ok = !pub_pending && !pub_failed;
+    pub_pending = 0;
+    pub_failed = false;
+    return ok;
+  }
+
+  virtual bool subscribe(const char* topic, uint8_t qos = 0) {
+    at->sendAT(GF("+QMTSUB=0,"), nextId(), GF(",\""), topic, GF("\","), qos);
+    return waitResult(GF(GSM_NL "+QMTSUB:"));
+  }
+
+  virtual bool unsubscribe(const char* topic) {
+    at->sendAT(GF("+QMTUNS=0,"), nextId(), GF(",\""), topic, '"');
+    return waitResult(GF(GSM_NL "+QMTUNS:"));
+  }
+
+protected:
+  virtual void poll() {
+    at->maintain();
+  }
+
+  uint16_t nextId() {
+    if (++msg_id == 0) msg_id = 1;
+    return msg_id;
+  }
+
+  // "<urc> 0,<msgid>,<result>[,<value>]", result 0 is success
+  bool waitResult(GsmConstStr urc) {
+    if (at->waitResponse() != 1 ||
+        at->waitResponse(15000L, urc) != 1) {
+      return false;
+    }
+    at->streamSkipUntil(',');  // Skip client index
+    at->streamSkipUntil(',');  // Skip message id
+    return at->stream.readStringUntil('\n').toInt() == 0;
+  }
+
+  TinyGsmBG96*  at;
+  bool          is_connected;
+  uint8_t       pub_pending;
+  bool          pub_failed;
+  uint16_t      msg_id;
+  int           close_reason;
+};
+
 //============================================================================//
 //============================================================================//
 //                          The BG96 Modem Functions
@@ -232,6 +720,11 @@ public:
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    memset(udps, 0, sizeof(udps));
+    server_session = NULL;
+    mqtt_session = NULL;
+    dns_ip[0] = '\0';
+    dns_state = 0;
   }
 
   /*
@@ -568,21 +1061,86 @@ public:
       return false;
     }
 
-    uint16_t* t = (uint16_t*)text;
-    for (size_t i=0; i<len; i++) {
-      uint8_t c = t[i] >> 8;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-      c = t[i] & 0xFF;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-    }
+    TinyGsmWriteHex16(stream, (const uint16_t*)text, len);
     stream.write((char)0x1A);
     stream.flush();
     return waitResponse(60000L) == 1;
   }
 
 
+  /*
+   * File system functions
+   */
+
+  // The modem downloads url over its own HTTP stack straight into
+  // "UFS:<filename>", at radio speed and without the MCU in the loop.
+  // Returns the HTTP status, or 0 on failure; size gets the file length.
+  int httpGetToFile(const char* url, const char* filename, uint32_t* size = NULL,
+                    uint16_t timeout_s = 300)
+  {
+    sendAT(GF("+QHTTPCFG=\"contextid\",1"));
+    if (waitResponse() != 1) {
+      return 0;
+    }
+    sendAT(GF("+QHTTPCFG=\"responseheader\",0"));
+    waitResponse();
+
+    sendAT(GF("+QHTTPURL="), (uint16_t)strlen(url), GF(",80"));
+    if (waitResponse(5000L, GF(GSM_NL "CONNECT")) != 1) {
+      return 0;
+    }
+    stream.print(url);
+    if (waitResponse(10000L) != 1) {
+      return 0;
+    }
+
+    // +QHTTPGET: <err>[,<status>[,<content length>]]
+    sendAT(GF("+QHTTPGET="), timeout_s);
+    if (waitResponse() != 1 ||
+        waitResponse(1000L * timeout_s, GF(GSM_NL "+QHTTPGET:")) != 1) {
+      return 0;
+    }
+    String res = stream.readStringUntil('\n');
+    int coma = res.indexOf(',');
+    if (res.toInt() != 0 || coma < 0) {
+      DBG("### HTTP GET error:", res);
+      return 0;
+    }
+    int status = res.substring(coma + 1).toInt();
+
+    deleteFile(filename);
+    sendAT(GF("+QHTTPREADFILE=\"UFS:"), filename, GF("\","), timeout_s);
+    if (waitResponse() != 1 ||
+        waitResponse(1000L * timeout_s, GF(GSM_NL "+QHTTPREADFILE:")) != 1) {
+      return 0;
+    }
+    if (stream.readStringUntil('\n').toInt() != 0) {
+      return 0;
+    }
+    if (size) {
+      int32_t len = getFileSize(filename);
+      *size = len > 0 ? len : 0;
+    }
+    return status;
+  }
+
+  // -1 if the file doesn't exist
+  int32_t getFileSize(const char* filename) {
+    sendAT(GF("+QFLST=\"UFS:"), filename, '"');
+    if (waitResponse(GF(GSM_NL "+QFLST:")) != 1) {
+      return -1;
+    }
+    streamSkipUntil(',');  // Skip name
+    int32_t res = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    return res;
+  }
+
+  bool deleteFile(const char* filename) {
+    sendAT(GF("+QFDEL=\"UFS:"), filename, '"');
+    return waitResponse() == 1;
+  }
+
   /*
    * Location functions
    */
@@ -616,18 +1174,37 @@ protected:
     return (0 == rsp);
   }
 
-  int modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+QISEND="), mux, ',', len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
-    }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
-      return 0;
+  // Only waits for the command to be accepted, the outcome is reported
+  // later by the "+QIOPEN:" URC
+  bool modemConnectAsync(const char* host, uint16_t port, uint8_t mux) {
+    sendAT(GF("+QIOPEN=1,"), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port, GF(",0,0"));
+    return waitResponse() == 1;
+  }
+
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most TINY_GSM_SEND_MAX bytes
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+QISEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        break;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
+        break;
+      }
+      sent += chunk;
     }
     // TODO: Wait for ACK? AT+QISEND=id,0
-    return len;
+    return sent;
   }
 
   size_t modemRead(size_t size, uint8_t mux) {
@@ -647,6 +1224,93 @@ protected:
     return len;
   }
 
+  bool modemListen(uint16_t port, uint8_t mux) {
+    sendAT(GF("+QIOPEN=1,"), mux, GF(",\"TCP LISTENER\",\"127.0.0.1\",0,"), port, GF(",0"));
+    waitResponse();
+
+    if (waitResponse(20000L, GF(GSM_NL "+QIOPEN:")) != 1) {
+      return false;
+    }
+    if (stream.readStringUntil(',').toInt() != mux) {
+      return false;
+    }
+    return 0 == stream.readStringUntil('\n').toInt();
+  }
+
+  bool modemOpenUdp(uint16_t localPort, uint8_t mux) {
+    sendAT(GF("+QIOPEN=1,"), mux, GF(",\"UDP SERVICE\",\"127.0.0.1\",0,"), localPort, GF(",0"));
+    waitResponse();
+
+    if (waitResponse(20000L, GF(GSM_NL "+QIOPEN:")) != 1) {
+      return false;
+    }
+    if (stream.readStringUntil(',').toInt() != mux) {
+      return false;
+    }
+    return 0 == stream.readStringUntil('\n').toInt();
+  }
+
+  // QISEND on a UDP service only takes an IP address
+  bool modemResolve(const char* host, String& ip) {
+    IPAddress tmp;
+    ip = host;
+    if (TinyGsmUdp::parseIp(ip, tmp)) {
+      return true;
+    }
+    // The answer comes as "dnsgip" URCs, see waitResponse()
+    dns_ip[0] = '\0';
+    dns_state = 0;
+    sendAT(GF("+QIDNSGIP=1,\""), host, GF("\""));
+    if (waitResponse() != 1) {
+      return false;
+    }
+    for (uint32_t start = millis(); !dns_state && millis() - start < 60000L; ) {
+      waitResponse(100, NULL, NULL);
+    }
+    ip = dns_ip;
+    return dns_state == 1;
+  }
+
+  int modemSendTo(const char* host, uint16_t port, const void* buff, size_t len,
+                  uint8_t mux) {
+    String ip;
+    if (!modemResolve(host, ip)) {
+      return 0;
+    }
+    sendAT(GF("+QISEND="), mux, ',', len, GF(",\""), ip, GF("\","), port);
+    if (waitResponse(GF(">")) != 1) {
+      return 0;
+    }
+    stream.write((uint8_t*)buff, len);
+    stream.flush();
+    if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
+      return 0;
+    }
+    return len;
+  }
+
+  // +QIRD: <len>,"<ip>",<port>
+  // A datagram longer than size is cut off by the modem
+  size_t modemReadFrom(uint8_t* buf, size_t size, uint8_t mux,
+                       String& ip, uint16_t& port) {
+    sendAT(GF("+QIRD="), mux, ',', size);
+    if (waitResponse(GF("+QIRD:")) != 1) {
+      return 0;
+    }
+    String res = stream.readStringUntil('\n');
+    size_t len = res.toInt();
+    if (len) {
+      int q1 = res.indexOf('"');
+      int q2 = res.indexOf('"', q1 + 1);
+      ip = res.substring(q1 + 1, q2);
+      port = res.substring(q2 + 2).toInt();
+      len = stream.readBytes(buf, TinyGsmMin(len, size));
+    }
+    waitResponse();
+    DBG("### READ:", mux, ",", len);
+    return len;
+  }
+
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+QIRD="), mux, GF(",0"));
     size_t result = 0;
@@ -763,7 +1427,31 @@ public:
             DBG("### URC RECV:", mux);
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
               sockets[mux]->got_data = true;
+            } else if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && udps[mux]) {
+              udps[mux]->got_data = true;
+            }
+          } else if (urc == "incoming") {
+            // "incoming",<id>,<server id>,"<ip>",<port>
+            int mux = stream.readStringUntil(',').toInt();
+            stream.readStringUntil('\n');
+            DBG("### URC INCOMING:", mux);
+            if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && server_session) {
+              server_session->pending |= (1 << mux);
             }
+          } else if (urc == "dnsgip") {
+            // First "<err>,<count>,<ttl>", then one line per "<ip>"
+            String res = stream.readStringUntil('\n');
+            res.trim();
+            if (res.startsWith("\"")) {
+              if (dns_state == 0) {
+                res.replace("\"", "");
+                res.toCharArray(dns_ip, sizeof(dns_ip));
+                dns_state = 1;
+              }
+            } else if (res.toInt() != 0) {
+              dns_state = -1;
+            }
+            DBG("### URC DNS:", res);
           } else if (urc == "closed") {
             int mux = stream.readStringUntil('\n').toInt();
             DBG("### URC CLOSE:", mux);
@@ -774,6 +1462,54 @@ public:
             stream.readStringUntil('\n');
           }
           data = "";
+        } else if (data.endsWith(GF(GSM_NL "+QIOPEN:"))) {
+          // Only reached for connectAsync(), a blocking connect waits for it in r1
+          int mux = stream.readStringUntil(',').toInt();
+          int err = stream.readStringUntil('\n').toInt();
+          DBG("### URC OPEN:", mux, err);
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+            sockets[mux]->sock_connected = (err == 0);
+            sockets[mux]->sock_connecting = false;
+          }
+          data = "";
+        } else if (data.endsWith(GF(GSM_NL "+QMTRECV:"))) {
+          // +QMTRECV: <client>,<msgid>,"<topic>",<length>,"<payload>"
+          streamSkipUntil('"');
+          String topic = stream.readStringUntil('"');
+          streamSkipUntil(',');
+          size_t len = stream.readStringUntil(',').toInt();
+          streamSkipUntil('"');
+          if (mqtt_session) {
+            mqtt_session->readMessage(topic, stream, len);
+          }
+          streamSkipUntil('\n');
+          data = "";
+          DBG("### MQTT RECV:", topic, len);
+        } else if (data.endsWith(GF(GSM_NL "+QMTPUB:"))) {
+          // +QMTPUB: <client>,<msgid>,<result>[,<value>]
+          streamSkipUntil(',');
+          streamSkipUntil(',');
+          int res = stream.readStringUntil('\n').toInt();
+          if (mqtt_session && res != 1) {  // 1 is a retransmission, not the outcome
+            if (mqtt_session->pub_pending) {
+              mqtt_session->pub_pending--;
+            }
+            if (res == 2) {
+              mqtt_session->pub_failed = true;
+            }
+          }
+          data = "";
+          DBG("### MQTT PUB:", res);
+        } else if (data.endsWith(GF(GSM_NL "+QMTSTAT:"))) {
+          // Connection to the broker is gone
+          streamSkipUntil(',');
+          int err = stream.readStringUntil('\n').toInt();
+          if (mqtt_session) {
+            mqtt_session->is_connected = false;
+            mqtt_session->close_reason = err;
+          }
+          data = "";
+          DBG("### MQTT STAT:", err);
         }
       }
     } while (millis() - startMillis < timeout);
@@ -808,6 +1544,11 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  GsmUdp*       udps[TINY_GSM_MUX_COUNT];
+  GsmServer*    server_session;
+  Mqtt*         mqtt_session;
+  char          dns_ip[16];
+  int8_t        dns_state;    // 0 pending, 1 resolved, -1 failed
 };
 
 #endif
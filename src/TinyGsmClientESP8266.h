@@ -17,6 +17,9 @@
 
 #define TINY_GSM_MUX_COUNT 5
 
+// Largest single CIPSEND
+#define TINY_GSM_SEND_MAX 2048
+
 #include <TinyGsmCommon.h>
 
 #define GSM_NL "\r\n"
@@ -122,6 +125,12 @@ public:
     return write((const uint8_t *)str, strlen(str));
   }
 
+  virtual size_t writev(const TinyGsmSegment* segs, size_t count) {
+    TINY_GSM_YIELD();
+    //at->maintain();
+    return at->modemSendv(segs, count, mux);
+  }
+
   virtual int available() {
     TINY_GSM_YIELD();
     if (!rx.size() && sock_connected) {
@@ -209,6 +218,114 @@ public:
 };
 
 
+//============================================================================//
+//============================================================================//
+//                          The ESP8266 Server Class
+//============================================================================//
+//============================================================================//
+
+/*
+ * TCP server on CIPSERVER. Every incoming connection gets a free link id,
+ * reported as "<id>,CONNECT". The ESP8266 pushes received data right away,
+ * so a client passed to accept() is kept waiting and the next connection
+ * is bound to it as soon as it arrives; data for a connection nobody
+ * waits for is dropped.
+ *
+ *   server.begin(80);
+ *   ...
+ *   if (server.accept(peer)) { peer.read(...); }
+ */
+class GsmServer
+{
+  friend class TinyGsmESP8266;
+
+public:
+  GsmServer() {}
+
+  GsmServer(TinyGsmESP8266& modem) {
+    init(&modem);
+  }
+
+  virtual ~GsmServer() {}
+
+  bool init(TinyGsmESP8266* modem) {
+    this->at = modem;
+    pending = 0;
+    waiting = NULL;
+    accepted = NULL;
+    listening = false;
+    return true;
+  }
+
+  bool begin(uint16_t port) {
+    at->server_session = this;
+    at->sendAT(GF("+CIPSERVER=1,"), port);
+    listening = (at->waitResponse() == 1);
+    return listening;
+  }
+
+  // Returns true once a connection is bound to client.
+  // Otherwise client waits for the next one, call again later.
+  bool accept(GsmClient& client) {
+    at->maintain();
+    if (accepted == &client) {
+      accepted = NULL;
+      return true;
+    }
+    for (uint8_t mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      if (pending & (1 << mux)) {
+        pending &= ~(1 << mux);
+        bind(client, mux);
+        return true;
+      }
+    }
+    waiting = &client;
+    return false;
+  }
+
+  // Stops listening, accepted connections stay open
+  void stop() {
+    at->sendAT(GF("+CIPSERVER=0"));
+    at->waitResponse();
+    listening = false;
+    pending = 0;
+    waiting = NULL;
+    accepted = NULL;
+    if (at->server_session == this) {
+      at->server_session = NULL;
+    }
+  }
+
+  operator bool() {
+    return listening;
+  }
+
+private:
+  void bind(GsmClient& client, uint8_t mux) {
+    client.init(at, mux);
+    client.rx.clear();
+    client.sock_connected = true;
+  }
+
+  // Called for "<id>,CONNECT"
+  void incoming(uint8_t mux) {
+    if (waiting) {
+      bind(*waiting, mux);
+      accepted = waiting;
+      waiting = NULL;
+    } else {
+      pending |= (1 << mux);
+      at->sockets[mux] = NULL;
+    }
+  }
+
+  TinyGsmESP8266* at;
+  uint16_t        pending;
+  GsmClient*      waiting;
+  GsmClient*      accepted;
+  bool            listening;
+};
+
 //============================================================================//
 //============================================================================//
 //                          The ESP8266 Modem Functions
@@ -225,6 +342,8 @@ public:
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    server_session = NULL;
+    connecting_mux = -1;
   }
 
   /*
@@ -434,27 +553,41 @@ protected:
       sendAT(GF("+CIPSSLSIZE=4096"));
       waitResponse();
     }
+    connecting_mux = mux;
     sendAT(GF("+CIPSTART="), mux, ',', ssl ? GF("\"SSL") : GF("\"TCP"), GF("\",\""), host, GF("\","), port, GF(","), TINY_GSM_TCP_KEEP_ALIVE);
     // TODO: Check mux
     int rsp = waitResponse(75000L,
                            GFP(GSM_OK),
                            GFP(GSM_ERROR),
                            GF("ALREADY CONNECT"));
+    connecting_mux = -1;
     // if (rsp == 3) waitResponse();  // May return "ERROR" after the "ALREADY CONNECT"
     return (1 == rsp);
   }
 
-  int modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+CIPSEND="), mux, ',', len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
-    }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(10000L, GF(GSM_NL "SEND OK" GSM_NL)) != 1) {
-      return 0;
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most TINY_GSM_SEND_MAX bytes
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        break;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(10000L, GF(GSM_NL "SEND OK" GSM_NL)) != 1) {
+        break;
+      }
+      sent += chunk;
     }
-    return len;
+    return sent;
   }
 
   bool modemGetConnected(uint8_t mux) {
@@ -537,6 +670,15 @@ public:
           int mux = stream.readStringUntil(',').toInt();
           int len = stream.readStringUntil(':').toInt();
           int len_orig = len;
+          if (mux < 0 || mux >= TINY_GSM_MUX_COUNT || !sockets[mux]) {
+            DBG("### Dropped: ", len, "on", mux);
+            while (len--) {
+              while (!stream.available()) { TINY_GSM_YIELD(); }
+              stream.read();
+            }
+            data = "";
+            continue;
+          }
           if (len > sockets[mux]->rx.free()) {
             DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
           } else {
@@ -550,6 +692,14 @@ public:
             DBG("### Fewer characters received than expected: ", sockets[mux]->available(), " vs ", len_orig);
           }
           data = "";
+        } else if (data.endsWith(GF(",CONNECT" GSM_NL))) {
+          int nl = data.lastIndexOf('\n', data.length() - 11);
+          int mux = data.substring(nl + 1).toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && mux != connecting_mux && server_session) {
+            server_session->incoming(mux);
+            DBG("### Incoming:", mux);
+          }
+          data = "";
         } else if (data.endsWith(GF("CLOSED"))) {
           int muxStart = max(0,data.lastIndexOf(GSM_NL, data.length()-8));
           int coma = data.indexOf(',', muxStart);
@@ -593,6 +743,8 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  GsmServer*    server_session;
+  int8_t        connecting_mux;   // Its "<id>,CONNECT" is not an incoming one
 };
 
 #endif
@@ -123,6 +123,12 @@ public:
     return write((const uint8_t *)str, strlen(str));
   }
 
+  virtual size_t writev(const TinyGsmSegment* segs, size_t count) {
+    TINY_GSM_YIELD();
+    //at->maintain();
+    return at->modemSendv(segs, count, mux);
+  }
+
   virtual int available() {
     TINY_GSM_YIELD();
     if (!rx.size() && sock_connected) {
@@ -588,18 +594,24 @@ protected:
   }
 
   int modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+TCPSEND="), mux, ',', len);
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  int modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    sendAT(GF("+TCPSEND="), mux, ',', total);
     if (waitResponse(GF(">")) != 1) {
       return 0;
     }
-    stream.write((uint8_t*)buff, len);
+    TinyGsmWriteSegments(stream, segs, count);
     stream.write((char)0x0D);
     stream.flush();
     if (waitResponse(30000L, GF(GSM_NL "+TCPSEND:")) != 1) {
       return 0;
     }
     stream.readStringUntil('\n');
-    return len;
+    return total;
   }
 
   bool modemGetConnected(uint8_t mux) {
@@ -18,6 +18,9 @@
 
 #define TINY_GSM_MUX_COUNT 6
 
+// Largest single QISEND
+#define TINY_GSM_SEND_MAX 1460
+
 #include <TinyGsmCommon.h>
 
 #define GSM_NL "\r\n"
@@ -489,15 +492,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
       return false;
     }
 
-    uint16_t* t = (uint16_t*)text;
-    for (size_t i=0; i<len; i++) {
-      uint8_t c = t[i] >> 8;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-      c = t[i] & 0xFF;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-    }
+    TinyGsmWriteHex16(stream, (const uint16_t*)text, len);
     stream.write((char)0x1A);
     stream.flush();
     return waitResponse(60000L) == 1;
@@ -619,35 +614,32 @@ protected:
    return (1 == rsp);
   }
 
-  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+QISEND="), mux, ',', (uint16_t)len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
-    }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
-      return 0;
-    }
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
 
-    // bool allAcknowledged = false;
-    // // bool failed = false;
-    // while ( !allAcknowledged ) {
-    //   sendAT( GF("+QISACK"));
-    //   if (waitResponse(5000L, GF(GSM_NL "+QISACK:")) != 1) {
-    //     return -1;
-    //   } else {
-    //     streamSkipUntil(',');  // Skip total length sent on connection
-    //     streamSkipUntil(',');  // Skip length already acknowledged by remote
-    //     // Make sure the total length un-acknowledged is 0
-    //     if ( stream.readStringUntil('\n').toInt() == 0 ) {
-    //       allAcknowledged = true;
-    //     }
-    //   }
-    // }
-    // waitResponse(5000L);
+  // Splits the data into sends of at most TINY_GSM_SEND_MAX bytes.
+  // Returns the bytes the modem took ("SEND OK"), the remote ACK
+  // (AT+QISACK) is not waited for.
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+QISEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        break;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
+        break;
+      }
+      sent += chunk;
+    }
 
-    return len;  // TODO
+    return sent;
   }
 
   size_t modemRead(size_t size, uint8_t mux) {
@@ -21,6 +21,9 @@
 
 #define TINY_GSM_MUX_COUNT 6
 
+// Largest single QISEND
+#define TINY_GSM_SEND_MAX 1460
+
 #include <TinyGsmCommon.h>
 
 #define GSM_NL "\r\n"
@@ -473,15 +476,7 @@ TINY_GSM_MODEM_GET_GPRS_IP_CONNECTED()
       return false;
     }
 
-    uint16_t* t = (uint16_t*)text;
-    for (size_t i=0; i<len; i++) {
-      uint8_t c = t[i] >> 8;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-      c = t[i] & 0xFF;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-    }
+    TinyGsmWriteHex16(stream, (const uint16_t*)text, len);
     stream.write((char)0x1A);
     stream.flush();
     return waitResponse(60000L) == 1;
@@ -590,15 +585,29 @@ protected:
     return (1 == rsp);
   }
 
-  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+QISEND="), mux, ',', (uint16_t)len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
-    }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
-      return 0;
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most TINY_GSM_SEND_MAX bytes. The
+  // fragments go out back to back, the remote ACK is only awaited once
+  // at the end.
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+QISEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        return sent;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "SEND OK")) != 1) {
+        return sent;
+      }
+      sent += chunk;
     }
 
     bool allAcknowledged = false;
@@ -606,7 +615,7 @@ protected:
     while ( !allAcknowledged ) {
       sendAT( GF("+QISACK"));
       if (waitResponse(5000L, GF(GSM_NL "+QISACK:")) != 1) {
-        return -1;
+        return sent;  // The modem has taken it all, only the ACK is unknown
       } else {
         streamSkipUntil(','); /** Skip total */
         streamSkipUntil(','); /** Skip acknowledged data size */
@@ -617,10 +626,7 @@ protected:
     }
     waitResponse(5000L);
 
-    // streamSkipUntil(','); // Skip mux
-    // return stream.readStringUntil('\n').toInt();
-
-    return len;  // TODO
+    return sent;
   }
 
   size_t modemRead(size_t size, uint8_t mux) {
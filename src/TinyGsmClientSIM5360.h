@@ -18,6 +18,9 @@
 
 #define TINY_GSM_MUX_COUNT 10
 
+// Largest single CIPSEND
+#define TINY_GSM_SEND_MAX 1500
+
 #include <TinyGsmCommon.h>
 
 #define GSM_NL "\r\n"
@@ -538,15 +541,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
 
-    uint16_t* t = (uint16_t*)text;
-    for (size_t i=0; i<len; i++) {
-      uint8_t c = t[i] >> 8;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-      c = t[i] & 0xFF;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-    }
+    TinyGsmWriteHex16(stream, (const uint16_t*)text, len);
     stream.write((char)0x1A);
     stream.flush();
     return waitResponse(60000L) == 1;
@@ -674,20 +669,38 @@ protected:
     return true;
   }
 
-  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
-    }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "+CIPSEND:")) != 1) {
-      return 0;
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most TINY_GSM_SEND_MAX bytes
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        break;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "+CIPSEND:")) != 1) {
+        break;
+      }
+      streamSkipUntil(','); // Skip mux
+      streamSkipUntil(','); // Skip requested bytes to send
+      int confirmed = stream.readStringUntil('\n').toInt();
+      if (confirmed <= 0) {
+        break;
+      }
+      sent += confirmed;
+      if ((size_t)confirmed != chunk) {
+        break;
+      }
     }
-    streamSkipUntil(','); // Skip mux
-    streamSkipUntil(','); // Skip requested bytes to send
-    // TODO:  make sure requested and confirmed bytes match
-    return stream.readStringUntil('\n').toInt();
+    return sent;
   }
 
   size_t modemRead(size_t size, uint8_t mux) {
@@ -708,20 +721,19 @@ protected:
     //  ^^ Requested number of data bytes (1-1460 bytes)to be read
     int len_confirmed = stream.readStringUntil('\n').toInt();
     // ^^ The data length which not read in the buffer
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
 #ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
+    if (TinyGsmReadHex(stream, sockets[mux]->rx, len_requested,
+                       sockets[mux]->_timeout) != (size_t)len_requested) {
+      DBG("### Bad HEX data from", mux);
+    }
 #else
+    for (int i=0; i<len_requested; i++) {
+      uint32_t startMillis = millis();
       while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
       char c = stream.read();
-#endif
       sockets[mux]->rx.put(c);
     }
+#endif
     DBG("### READ:", len_requested, "from", mux);
     // sockets[mux]->sock_available = modemGetAvailable(mux);
     sockets[mux]->sock_available = len_confirmed;
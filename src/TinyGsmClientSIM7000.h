@@ -18,7 +18,12 @@
 
 #define TINY_GSM_MUX_COUNT 8
 
+// Used until the modem reports the limit with AT+CIPSEND?
+#define TINY_GSM_SEND_MAX 1460
+
 #include <TinyGsmCommon.h>
+#include <TinyGsmMqtt.h>
+#include <TinyGsmUdp.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -146,12 +151,129 @@ public:
 */
 
 
+/*
+ * UDP on a CIPSTART "UDP" connection, see TinyGsmUdpConnected.
+ * The mux (2 by default) must not be one a GsmClient was created on.
+ */
+class GsmUdp : public TinyGsmUdpConnected<TinyGsmSim7000>
+{
+  friend class TinyGsmSim7000;
+
+public:
+  GsmUdp() {}
+
+  GsmUdp(TinyGsmSim7000& modem, uint8_t mux = 2) {
+    init(&modem, mux);
+  }
+};
+
+friend class TinyGsmUdpConnected<TinyGsmSim7000>;
+
+
+/*
+ * The modem's own MQTT client (AT+SM*)
+ */
+class Mqtt : public TinyGsmMqtt
+{
+  friend class TinyGsmSim7000;
+
+public:
+  Mqtt() {}
+
+  Mqtt(TinyGsmSim7000& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim7000* modem) {
+    this->at = modem;
+    is_connected = false;
+    at->mqtt_session = this;
+    return true;
+  }
+
+  using TinyGsmMqtt::publish;
+
+  virtual bool connect(const char* host, uint16_t port, const char* clientId,
+                       const char* user = NULL, const char* pass = NULL)
+  {
+    if (is_connected) {
+      disconnect();
+    }
+    at->sendAT(GF("+SMCONF=\"URL\",\""), host, GF("\",\""), port, '"');
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    at->sendAT(GF("+SMCONF=\"KEEPTIME\","), keepalive_s);
+    at->waitResponse();
+    at->sendAT(GF("+SMCONF=\"CLEANSS\",1"));
+    at->waitResponse();
+    at->sendAT(GF("+SMCONF=\"CLIENTID\",\""), clientId, '"');
+    at->waitResponse();
+    if (user) {
+      at->sendAT(GF("+SMCONF=\"USERNAME\",\""), user, '"');
+      at->waitResponse();
+      at->sendAT(GF("+SMCONF=\"PASSWORD\",\""), pass ? pass : "", '"');
+      at->waitResponse();
+    }
+    at->sendAT(GF("+SMCONN"));
+    is_connected = at->waitResponse(60000L) == 1;
+    return is_connected;
+  }
+
+  virtual void disconnect() {
+    at->sendAT(GF("+SMDISC"));
+    at->waitResponse();
+    is_connected = false;
+  }
+
+  virtual bool connected() {
+    return is_connected;
+  }
+
+  // The modem answers once the message is sent (QoS 0) or acknowledged,
+  // so there is nothing left for flush() to wait for
+  virtual bool publish(const char* topic, const void* payload, size_t len,
+                       uint8_t qos = 0, bool retain = false)
+  {
+    at->sendAT(GF("+SMPUB=\""), topic, GF("\","), (uint16_t)len, ',', qos, ',', retain);
+    if (at->waitResponse(GF(">")) != 1) {
+      return false;
+    }
+    at->stream.write((const uint8_t*)payload, len);
+    at->stream.flush();
+    return at->waitResponse(10000L) == 1;
+  }
+
+  virtual bool subscribe(const char* topic, uint8_t qos = 0) {
+    at->sendAT(GF("+SMSUB=\""), topic, GF("\","), qos);
+    return at->waitResponse(10000L) == 1;
+  }
+
+  virtual bool unsubscribe(const char* topic) {
+    at->sendAT(GF("+SMUNSUB=\""), topic, '"');
+    return at->waitResponse(10000L) == 1;
+  }
+
+protected:
+  virtual void poll() {
+    at->maintain();
+  }
+
+  TinyGsmSim7000* at;
+  bool            is_connected;
+};
+
+
 public:
 
   TinyGsmSim7000(Stream& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    memset(udps, 0, sizeof(udps));
+    hex_send = false;
+    memset(send_max, 0, sizeof(send_max));
+    mqtt_session = NULL;
   }
 
   virtual ~TinyGsmSim7000() {}
@@ -434,6 +556,15 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
 
+#ifdef TINY_GSM_USE_HEX
+    // Take CIPSEND data as hex digits, older firmware doesn't know it
+    sendAT(GF("+CIPSENDHEX=1"));
+    hex_send = waitResponse() == 1;
+    if (!hex_send) {
+      DBG("### CIPSENDHEX not supported, sending binary");
+    }
+#endif
+
     // Start Task and Set APN, USER NAME, PASSWORD
     sendAT(GF("+CSTT=\""), apn, GF("\",\""), user, GF("\",\""), pwd, GF("\""));
     if (waitResponse(60000L) != 1) {
@@ -577,15 +708,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
 
-    uint16_t* t = (uint16_t*)text;
-    for (size_t i=0; i<len; i++) {
-      uint8_t c = t[i] >> 8;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-      c = t[i] & 0xFF;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-    }
+    TinyGsmWriteHex16(stream, (const uint16_t*)text, len);
     stream.write((char)0x1A);
     stream.flush();
     return waitResponse(60000L) == 1;
@@ -821,6 +944,7 @@ protected:
 
    int rsp;
    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+   send_max[mux] = 0;
    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","),
           port);
    rsp = waitResponse(
@@ -831,18 +955,52 @@ protected:
    return (1 == rsp);
   }
 
-  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most modemSendMax() bytes. In quick
+  // send mode (CIPQSEND=1) each one is confirmed as soon as the modem has
+  // buffered it, so the fragments go out back to back.
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)modemSendMax(mux));
+      sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        break;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk, hex_send);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) {
+        break;
+      }
+      streamSkipUntil(','); // Skip mux
+      size_t accepted = stream.readStringUntil('\n').toInt();
+      sent += accepted;
+      if (accepted != chunk) {
+        break;
+      }
     }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) {
-      return 0;
+    return sent;
+  }
+
+  // Largest single send on the connection, queried once per connection
+  uint16_t modemSendMax(uint8_t mux) {
+    if (send_max[mux]) {
+      return send_max[mux];
     }
-    streamSkipUntil(','); // Skip mux
-    return stream.readStringUntil('\n').toInt();
+    sendAT(GF("+CIPSEND?"));
+    while (waitResponse(GF("+CIPSEND:"), GFP(GSM_OK)) == 1) {
+      uint8_t n = stream.readStringUntil(',').toInt();
+      uint16_t size = stream.readStringUntil('\n').toInt();
+      if (n == mux) {
+        send_max[mux] = size;
+      }
+    }
+    return send_max[mux] ? send_max[mux] : TINY_GSM_SEND_MAX;
   }
 
   size_t modemRead(size_t size, uint8_t mux) {
@@ -865,20 +1023,19 @@ protected:
     // ^^ Confirmed number of data bytes to be read, which may be less than requested.
     // 0 indicates that no data can be read.
     // This is actually be the number of bytes that will be remaining after the read
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
 #ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
+    if (TinyGsmReadHex(stream, sockets[mux]->rx, len_requested,
+                       sockets[mux]->_timeout) != (size_t)len_requested) {
+      DBG("### Bad HEX data from", mux);
+    }
 #else
+    for (int i=0; i<len_requested; i++) {
+      uint32_t startMillis = millis();
       while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
       char c = stream.read();
-#endif
       sockets[mux]->rx.put(c);
     }
+#endif
     DBG("### READ:", len_requested, "from", mux);
     // sockets[mux]->sock_available = modemGetAvailable(mux);
     sockets[mux]->sock_available = len_confirmed;
@@ -886,6 +1043,40 @@ protected:
     return len_requested;
   }
 
+  bool modemConnectUdp(const char* host, uint16_t port, uint16_t localPort,
+                       uint8_t mux)
+  {
+    if (localPort) {
+      sendAT(GF("+CLPORT="), mux, GF(",\"UDP\","), localPort);
+      waitResponse();
+    }
+    send_max[mux] = 0;
+    sendAT(GF("+CIPSTART="), mux, ',', GF("\"UDP"), GF("\",\""), host, GF("\","), port);
+    int rsp = waitResponse(75000L,
+                           GF("CONNECT OK" GSM_NL),
+                           GF("CONNECT FAIL" GSM_NL),
+                           GF("ALREADY CONNECT" GSM_NL),
+                           GF("ERROR" GSM_NL));
+    return (1 == rsp);
+  }
+
+  // Reads straight into the caller's buffer, always in binary mode
+  size_t modemReadUdp(uint8_t* buf, size_t size, uint8_t mux) {
+    sendAT(GF("+CIPRXGET=2,"), mux, ',', (uint16_t)size);
+    if (waitResponse(GF("+CIPRXGET:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(','); // Skip mode 2
+    streamSkipUntil(','); // Skip mux
+    int len_requested = stream.readStringUntil(',').toInt();
+    int len_remaining = stream.readStringUntil('\n').toInt();
+    size_t len = stream.readBytes(buf, len_requested);
+    udps[mux]->got_data = len_remaining > 0;
+    DBG("### READ:", len, "from", mux);
+    waitResponse();
+    return len;
+  }
+
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
@@ -959,6 +1150,8 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
             int mux = stream.readStringUntil('\n').toInt();
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
               sockets[mux]->got_data = true;
+            } else if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && udps[mux]) {
+              udps[mux]->got_data = true;
             }
             data = "";
             DBG("### Got Data:", mux);
@@ -983,6 +1176,25 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           }
           data = "";
           DBG("### Closed: ", mux);
+        } else if (data.endsWith(GF(GSM_NL "+SMSUB:"))) {
+          // +SMSUB: "<topic>","<payload>"
+          streamSkipUntil('"');
+          String topic = stream.readStringUntil('"');
+          streamSkipUntil('"');
+          if (mqtt_session) {
+            mqtt_session->readMessageLine(topic, stream);
+          } else {
+            streamSkipUntil('\n');
+          }
+          data = "";
+          DBG("### MQTT RECV:", topic);
+        } else if (data.endsWith(GF(GSM_NL "+SMSTATE: 0"))) {
+          // Connection to the broker is gone
+          if (mqtt_session) {
+            mqtt_session->is_connected = false;
+          }
+          data = "";
+          DBG("### MQTT disconnected");
         }
       }
     } while (millis() - startMillis < timeout_ms);
@@ -1018,6 +1230,10 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  GsmUdp*       udps[TINY_GSM_MUX_COUNT];
+  uint16_t      send_max[TINY_GSM_MUX_COUNT];
+  bool          hex_send;   // CIPSEND takes hex digits (CIPSENDHEX=1)
+  Mqtt*         mqtt_session;
 };
 
 #endif
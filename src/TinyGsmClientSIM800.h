@@ -19,11 +19,45 @@
 
 #define TINY_GSM_MUX_COUNT 5
 
+// Used until the modem reports the limit with AT+CIPSEND?
+#define TINY_GSM_SEND_MAX 1460
+
+// Largest block FTPGET=2 / FTPPUT=2 move at once
+#if !defined(TINY_GSM_FTP_BLOCK)
+  #define TINY_GSM_FTP_BLOCK 1460
+#endif
+
 #ifndef TINY_GSM_PHONEBOOK_RESULTS
   #define TINY_GSM_PHONEBOOK_RESULTS 5
 #endif
 
+// Indexes from +CMTI kept until they're taken, see getNewSmsIndex()
+#ifndef TINY_GSM_SMS_QUEUE
+  #define TINY_GSM_SMS_QUEUE 8
+#endif
+
+// Define TINY_GSM_SMS_DIRECT for messages delivered with +CMT instead of
+// being stored, see receiveNewMessageIndication(). It costs one SmsEntry.
+
+// Entries kept by TinyGsmPhonebookIndex, at most 255
+#ifndef TINY_GSM_PHONEBOOK_CACHE
+  #define TINY_GSM_PHONEBOOK_CACHE 250
+#endif
+
+// Trailing digits TinyGsmPhonebookIndex compares numbers by, at most 9.
+// Set it to the national number length, e.g. 8 where numbers have 8 digits
+// after the trunk prefix, or 0 12345678 won't match +XX 12345678.
+#ifndef TINY_GSM_PHONEBOOK_DIGITS
+  #define TINY_GSM_PHONEBOOK_DIGITS 9
+#endif
+
+#if TINY_GSM_PHONEBOOK_DIGITS < 1 || TINY_GSM_PHONEBOOK_DIGITS > 9
+  #error "TINY_GSM_PHONEBOOK_DIGITS must be 1..9"
+#endif
+
 #include <TinyGsmCommon.h>
+#include <TinyGsmPdu.h>
+#include <TinyGsmUdp.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -78,6 +112,97 @@ struct PhonebookMatches {
   uint8_t index[TINY_GSM_PHONEBOOK_RESULTS] = {0};
 };
 
+/*
+ * Phonebook numbers in RAM, so caller ID checks need no AT commands.
+ * Filled by TinyGsmSim800::loadPhonebook(). Numbers are compared by their
+ * last TINY_GSM_PHONEBOOK_DIGITS (9) digits, so +380501234567 and
+ * 0501234567 are the same number. Numbers with fewer digits than that
+ * must match exactly.
+ * Takes 7 bytes per entry, lookups hash into chains of about one entry.
+ */
+class TinyGsmPhonebookIndex
+{
+public:
+  TinyGsmPhonebookIndex() {
+    clear();
+  }
+
+  void clear() {
+    count = 0;
+    memset(buckets, EMPTY, sizeof(buckets));
+  }
+
+  // False if the table is full or number has no digits
+  bool add(uint8_t index, const char* number) {
+    uint32_t k = key(number);
+    if (!k || count >= TINY_GSM_PHONEBOOK_CACHE) {
+      return false;
+    }
+    uint8_t b = k % TINY_GSM_PHONEBOOK_CACHE;
+    keys[count] = k;
+    indexes[count] = index;
+    next[count] = buckets[b];
+    buckets[b] = count++;
+    return true;
+  }
+
+  // Storage index of the entry with this number, 0 if there is none
+  uint8_t find(const char* number) const {
+    uint32_t k = key(number);
+    if (!k) {
+      return 0;
+    }
+    for (uint8_t i = buckets[k % TINY_GSM_PHONEBOOK_CACHE]; i != EMPTY; i = next[i]) {
+      if (keys[i] == k) {
+        return indexes[i];
+      }
+    }
+    return 0;
+  }
+
+  uint8_t find(const String& number) const {
+    return find(number.c_str());
+  }
+
+  uint8_t size() const {
+    return count;
+  }
+
+  // Last TINY_GSM_PHONEBOOK_DIGITS digits as a number. Shorter numbers
+  // keep their length in the top bits, so 0123 and 123 differ. 0 if there
+  // are no digits.
+  static uint32_t key(const char* number) {
+    uint32_t k = 0;
+    uint32_t scale = 1;
+    uint8_t digits = 0;
+    for (const char* p = number + strlen(number);
+         p > number && digits < TINY_GSM_PHONEBOOK_DIGITS; ) {
+      char c = *--p;
+      if (c >= '0' && c <= '9') {
+        k += (c - '0') * scale;
+        scale *= 10;
+        digits++;
+      }
+    }
+    if (!digits) {
+      return 0;
+    }
+    if (digits < TINY_GSM_PHONEBOOK_DIGITS) {
+      return k | ((uint32_t)(digits + 1) << 27) | 0x80000000UL;
+    }
+    return k + 1;
+  }
+
+private:
+  static const uint8_t EMPTY = 0xFF;
+
+  uint32_t      keys[TINY_GSM_PHONEBOOK_CACHE];
+  uint8_t       indexes[TINY_GSM_PHONEBOOK_CACHE];
+  uint8_t       next[TINY_GSM_PHONEBOOK_CACHE];
+  uint8_t       buckets[TINY_GSM_PHONEBOOK_CACHE];
+  uint8_t       count;
+};
+
 enum class MessageStorageType : uint8_t {
   SIM,                // SM
   Phone,              // ME
@@ -132,7 +257,11 @@ public:
     this->mux = mux;
     sock_available = 0;
     prev_check = 0;
+    connect_start = 0;
+    connect_timeout_ms = 0;
     sock_connected = false;
+    sock_connecting = false;
+    sock_closing = false;
     got_data = false;
 
     at->sockets[mux] = this;
@@ -151,15 +280,71 @@ public:
 
 TINY_GSM_CLIENT_CONNECT_OVERLOADS()
 
+  // Starts connecting and returns as soon as the modem accepts the request.
+  // Completion arrives as a "<mux>, CONNECT OK/FAIL" URC, so several
+  // sockets can be opened in parallel; poll connecting() until it clears.
+  // Without an answer within timeout_s the socket is closed.
+  virtual int connectAsync(const char *host, uint16_t port, int timeout_s = 75) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_connecting = at->modemConnectAsync(host, port, mux, false);
+    connect_start = millis();
+    connect_timeout_ms = ((uint32_t)timeout_s)*1000;
+    return sock_connecting;
+  }
+
+  bool connecting() {
+    if (sock_connecting) {
+      at->maintain();
+    }
+    if (sock_connecting && millis() - connect_start > connect_timeout_ms) {
+      DBG("### Connect timed out on", mux);
+      stop();
+    }
+    return sock_connecting;
+  }
+
   virtual void stop(uint32_t maxWaitMs) {
     TINY_GSM_CLIENT_DUMP_MODEM_BUFFER()
     at->sendAT(GF("+CIPCLOSE="), mux, GF(",1"));  // Quick close
     sock_connected = false;
+    sock_connecting = false;
     at->waitResponse();
+    sock_closing = false;
   }
 
   virtual void stop() { stop(15000L); }
 
+  // Closes without draining the modem buffer first.
+  // Anything the modem still holds for this socket is dropped.
+  virtual void abort() {
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_available = 0;
+    got_data = false;
+    at->sendAT(GF("+CIPCLOSE="), mux, GF(",1"));  // Quick close
+    sock_connected = false;
+    sock_connecting = false;
+    at->waitResponse();
+    sock_closing = false;
+  }
+
+  // Same as abort(), but doesn't wait for the modem to answer.
+  // The "<mux>, CLOSE OK" that follows is swallowed by waitResponse().
+  virtual void stopAsync() {
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_available = 0;
+    got_data = false;
+    if (sock_connected || sock_connecting) {
+      at->sendAT(GF("+CIPCLOSE="), mux, GF(",1"));  // Quick close
+      sock_closing = true;
+    }
+    sock_connected = false;
+    sock_connecting = false;
+  }
+
 TINY_GSM_CLIENT_WRITE()
 
 TINY_GSM_CLIENT_AVAILABLE_WITH_BUFFER_CHECK()
@@ -179,7 +364,11 @@ private:
   uint8_t         mux;
   uint16_t        sock_available;
   uint32_t        prev_check;
+  uint32_t        connect_start;
+  uint32_t        connect_timeout_ms;
   bool            sock_connected;
+  bool            sock_connecting;
+  bool            sock_closing;
   bool            got_data;
   RxFifo          rx;
 };
@@ -204,6 +393,506 @@ public:
     sock_connected = at->modemConnect(host, port, mux, true, timeout_s);
     return sock_connected;
   }
+
+  virtual int connectAsync(const char *host, uint16_t port, int timeout_s = 75) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_connecting = at->modemConnectAsync(host, port, mux, true);
+    connect_start = millis();
+    connect_timeout_ms = ((uint32_t)timeout_s)*1000;
+    return sock_connecting;
+  }
+};
+
+/*
+ * TCP server on CIPSERVER. The modem takes a free mux for every incoming
+ * connection and reports it as "<mux>, REMOTE IP: <ip>"; accept() binds
+ * the next one to a GsmClient, which is then used like a connected one.
+ * Leave some muxes unused by your own clients for incoming connections.
+ *
+ *   TinyGsmSim800::GsmServer server(modem);
+ *   TinyGsmSim800::GsmClient peer;
+ *   server.begin(8080);
+ *   ...
+ *   if (server.accept(peer)) { peer.read(...); }
+ */
+class GsmServer
+{
+  friend class TinyGsmSim800;
+
+public:
+  GsmServer() {}
+
+  GsmServer(TinyGsmSim800& modem) {
+    init(&modem);
+  }
+
+  virtual ~GsmServer() {}
+
+  bool init(TinyGsmSim800* modem) {
+    this->at = modem;
+    pending = 0;
+    listening = false;
+    return true;
+  }
+
+  bool begin(uint16_t port) {
+    at->server_session = this;
+    at->sendAT(GF("+CIPSERVER=1,"), port);
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    listening = (at->waitResponse(5000L, GF("SERVER OK" GSM_NL)) == 1);
+    return listening;
+  }
+
+  // Binds the oldest waiting connection to client.
+  // Returns false if nobody has connected meanwhile.
+  bool accept(GsmClient& client) {
+    at->maintain();
+    for (uint8_t mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      if (pending & (1 << mux)) {
+        pending &= ~(1 << mux);
+        client.init(at, mux);
+        client.sock_connected = true;
+        at->send_max[mux] = 0;
+        // Data may have been announced before the client existed
+        client.got_data = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Stops listening, accepted connections stay open
+  void stop() {
+    at->sendAT(GF("+CIPSERVER=0"));
+    at->waitResponse();
+    listening = false;
+    pending = 0;
+    if (at->server_session == this) {
+      at->server_session = NULL;
+    }
+  }
+
+  operator bool() {
+    return listening;
+  }
+
+private:
+  TinyGsmSim800*  at;
+  uint16_t        pending;
+  bool            listening;
+};
+
+/*
+ * UDP on a CIPSTART "UDP" connection, see TinyGsmUdpConnected.
+ * The mux (2 by default) must not be one a GsmClient was created on.
+ */
+class GsmUdp : public TinyGsmUdpConnected<TinyGsmSim800>
+{
+  friend class TinyGsmSim800;
+
+public:
+  GsmUdp() {}
+
+  GsmUdp(TinyGsmSim800& modem, uint8_t mux = 2) {
+    init(&modem, mux);
+  }
+};
+
+friend class TinyGsmUdpConnected<TinyGsmSim800>;
+
+/*
+ * The modem's own HTTP(S) stack (AT+HTTP*), on the bearer opened by
+ * gprsConnect(). The modem does the TCP and HTTP work, only the body
+ * crosses the serial line, read with HTTPREAD in windows of the caller's
+ * buffer size.
+ *
+ *   TinyGsmSim800::Http http(modem);
+ *   if (http.begin() && http.get("http://example.com/data.bin") == 200) {
+ *     int n;
+ *     while ((n = http.read(buf, sizeof(buf))) > 0) { ... }
+ *   }
+ *   http.end();
+ */
+class Http
+{
+  friend class TinyGsmSim800;
+
+public:
+  Http() {}
+
+  Http(TinyGsmSim800& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim800* modem) {
+    this->at = modem;
+    pending = false;
+    status = 0;
+    content_length = 0;
+    read_offset = 0;
+    return true;
+  }
+
+  bool begin(bool ssl = false) {
+    at->sendAT(GF("+HTTPTERM"));  // In case a previous session was left open
+    at->waitResponse();
+    at->sendAT(GF("+HTTPINIT"));
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    at->http_session = this;
+    if (!setParameter(GF("CID"), "1")) {
+      return false;
+    }
+#if !defined(TINY_GSM_MODEM_SIM900)
+    at->sendAT(GF("+HTTPSSL="), ssl);
+    if (at->waitResponse() != 1 && ssl) {
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  void end() {
+    at->sendAT(GF("+HTTPTERM"));
+    at->waitResponse();
+    if (at->http_session == this) {
+      at->http_session = NULL;
+    }
+    pending = false;
+  }
+
+  // Extra request headers, "Name: value" pairs separated by "\r\n"
+  bool setHeaders(const char* headers) {
+    return setParameter(GF("USERDATA"), headers);
+  }
+
+  // Returns the HTTP status (6xx are modem side errors), or 0 on failure
+  int get(const char* url, uint32_t timeout_ms = 60000L) {
+    if (!getAsync(url)) {
+      return 0;
+    }
+    return wait(timeout_ms);
+  }
+
+  int post(const char* url, const char* contentType, const void* body, size_t len,
+           uint32_t timeout_ms = 60000L) {
+    if (!postAsync(url, contentType, body, len)) {
+      return 0;
+    }
+    return wait(timeout_ms);
+  }
+
+  // Start the request and return, completion arrives as +HTTPACTION.
+  // Poll finished() until it's true.
+  bool getAsync(const char* url) {
+    return setParameter(GF("URL"), url) && action(0);
+  }
+
+  bool postAsync(const char* url, const char* contentType, const void* body, size_t len) {
+    if (!setParameter(GF("URL"), url) ||
+        !setParameter(GF("CONTENT"), contentType) ||
+        !upload(body, len)) {
+      return false;
+    }
+    return action(1);
+  }
+
+  bool finished() {
+    if (pending) {
+      at->maintain();
+    }
+    return !pending;
+  }
+
+  int responseStatus() {
+    return status;
+  }
+
+  uint32_t contentLength() {
+    return content_length;
+  }
+
+  // Reads the next part of the body straight into buf.
+  // Returns the number of bytes read, 0 at the end, -1 on error.
+  int read(uint8_t* buf, size_t len) {
+    int res = read(buf, len, read_offset);
+    if (res > 0) {
+      read_offset += res;
+    }
+    return res;
+  }
+
+  // Reads from any offset, the body stays on the modem until end()
+  int read(uint8_t* buf, size_t len, uint32_t offset) {
+    if (offset >= content_length || !len) {
+      return 0;
+    }
+    at->sendAT(GF("+HTTPREAD="), offset, ',', (uint32_t)len);
+    int rsp = at->waitResponse(10000L, GF("+HTTPREAD:"), GFP(GSM_ERROR), GFP(GSM_OK));
+    if (rsp != 1) {
+      return rsp == 3 ? 0 : -1;
+    }
+    size_t avail = at->stream.readStringUntil('\n').toInt();
+    size_t res = at->stream.readBytes(buf, TinyGsmMin(avail, len));
+    at->waitResponse();
+    return res;
+  }
+
+private:
+  bool setParameter(GsmConstStr name, const char* value) {
+    at->sendAT(GF("+HTTPPARA=\""), name, GF("\",\""), value, '"');
+    return at->waitResponse() == 1;
+  }
+
+  bool upload(const void* body, size_t len) {
+    at->sendAT(GF("+HTTPDATA="), (uint32_t)len, GF(",10000"));
+    if (at->waitResponse(GF("DOWNLOAD")) != 1) {
+      return false;
+    }
+    at->stream.write((const uint8_t*)body, len);
+    at->stream.flush();
+    return at->waitResponse(10000L) == 1;
+  }
+
+  bool action(uint8_t method) {
+    status = 0;
+    content_length = 0;
+    read_offset = 0;
+    at->sendAT(GF("+HTTPACTION="), method);
+    pending = at->waitResponse() == 1;
+    return pending;
+  }
+
+  int wait(uint32_t timeout_ms) {
+    uint32_t startMillis = millis();
+    while (pending && millis() - startMillis < timeout_ms) {
+      at->waitResponse(100, NULL, NULL);
+    }
+    if (pending) {
+      pending = false;
+      return 0;
+    }
+    return status;
+  }
+
+  TinyGsmSim800*  at;
+  bool            pending;
+  int             status;
+  uint32_t        content_length;
+  uint32_t        read_offset;
+};
+
+/*
+ * The modem's own FTP client (AT+FTP*), on the bearer opened by
+ * gprsConnect(). Data moves in blocks of up to TINY_GSM_FTP_BLOCK bytes
+ * (FTPGET=2 / FTPPUT=2), the modem signals readiness with +FTPGET/+FTPPUT
+ * URCs instead of being polled.
+ *
+ *   TinyGsmSim800::Ftp ftp(modem);
+ *   ftp.begin("ftp.example.com", "user", "pass");
+ *   ftp.download("/logs/", "today.log", buf, sizeof(buf), onData);
+ *
+ *   ftp.beginUpload("/logs/", "unit1.log");
+ *   ftp.write(data, len);
+ *   ftp.endUpload();
+ */
+class Ftp
+{
+  friend class TinyGsmSim800;
+
+public:
+  // Receives downloaded data, return false to abort
+  typedef bool (*Sink)(const uint8_t* data, size_t len, void* arg);
+
+  Ftp() {}
+
+  Ftp(TinyGsmSim800& modem) {
+    init(&modem);
+  }
+
+  bool init(TinyGsmSim800* modem) {
+    this->at = modem;
+    timeout_ms = 60000L;
+    reset();
+    return true;
+  }
+
+  bool begin(const char* server, const char* user = "anonymous",
+             const char* pass = "", uint16_t port = 21)
+  {
+    at->ftp_session = this;
+    at->sendAT(GF("+FTPCID=1"));
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    at->sendAT(GF("+FTPMODE=1"));  // Passive, works behind the operator's NAT
+    at->waitResponse();
+    at->sendAT(GF("+FTPTYPE=\"I\""));
+    at->waitResponse();
+    return setParameter(GF("SERV"), server) &&
+           setParameter(GF("UN"), user) &&
+           setParameter(GF("PW"), pass) &&
+           setPort(port);
+  }
+
+  // Time to wait for the modem to get ready for the next block
+  void setTimeout(uint32_t ms) {
+    timeout_ms = ms;
+  }
+
+  // FTP result code of the last transfer (e.g. 66 = file not found), 0 if OK
+  int lastError() {
+    return error;
+  }
+
+  // Streams path/name to sink, reading blocks of up to len bytes into buf
+  bool download(const char* path, const char* name, uint8_t* buf, size_t len,
+                Sink sink, void* arg = NULL)
+  {
+    if (!setParameter(GF("GETPATH"), path) ||
+        !setParameter(GF("GETNAME"), name)) {
+      return false;
+    }
+    len = TinyGsmMin(len, (size_t)TINY_GSM_FTP_BLOCK);
+    reset();
+    at->sendAT(GF("+FTPGET=1"));
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    // FTPGET=2 is refused until the session is open ("+FTPGET: 1,1")
+    if (!waitEvent() || !ready) {
+      return done && !error;
+    }
+    for (;;) {
+      ready = false;
+      int n = readBlock(buf, len);
+      if (n < 0) {
+        // The session is gone once the transfer has finished
+        return done && !error;
+      }
+      if (n > 0) {
+        if (!sink(buf, n, arg)) {
+          at->sendAT(GF("+FTPQUIT"));
+          at->waitResponse();
+          return false;
+        }
+        continue;
+      }
+      if (done) {
+        return !error;
+      }
+      if (!waitEvent()) {
+        return false;
+      }
+    }
+  }
+
+  bool beginUpload(const char* path, const char* name) {
+    if (!setParameter(GF("PUTPATH"), path) ||
+        !setParameter(GF("PUTNAME"), name)) {
+      return false;
+    }
+    reset();
+    at->sendAT(GF("+FTPPUT=1"));
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    return waitEvent() && ready;
+  }
+
+  // Sends data in the largest blocks the modem accepts (usually 1360 bytes)
+  size_t write(const uint8_t* data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+      if (!ready && (!waitEvent() || !ready)) {
+        break;
+      }
+      // "+FTPPUT: 1,1,0" (or no length at all): FTPPUT=2,0 would end the upload
+      if (!put_max) {
+        DBG("### FTP upload refused, no room for data");
+        break;
+      }
+      uint16_t chunk = TinyGsmMin(len - sent, (size_t)put_max);
+      ready = false;
+      at->sendAT(GF("+FTPPUT=2,"), chunk);
+      if (at->waitResponse(GF(GSM_NL "+FTPPUT: 2,")) != 1) {
+        break;
+      }
+      at->streamSkipUntil('\n');
+      at->stream.write(data + sent, chunk);
+      at->stream.flush();
+      if (at->waitResponse(10000L) != 1) {
+        break;
+      }
+      sent += chunk;
+    }
+    return sent;
+  }
+
+  bool endUpload() {
+    at->sendAT(GF("+FTPPUT=2,0"));
+    if (at->waitResponse() != 1) {
+      return false;
+    }
+    while (!done) {
+      ready = false;  // Left over from the last block
+      if (!waitEvent()) {
+        return false;
+      }
+    }
+    return !error;
+  }
+
+private:
+  bool setParameter(GsmConstStr name, const char* value) {
+    at->sendAT(GF("+FTP"), name, GF("=\""), value, '"');
+    return at->waitResponse() == 1;
+  }
+
+  bool setPort(uint16_t port) {
+    at->sendAT(GF("+FTPPORT="), port);
+    return at->waitResponse() == 1;
+  }
+
+  void reset() {
+    ready = false;
+    done = false;
+    error = 0;
+    put_max = 0;
+  }
+
+  // Returns the number of bytes read, 0 if nothing is buffered, -1 on error
+  int readBlock(uint8_t* buf, size_t len) {
+    at->sendAT(GF("+FTPGET=2,"), (uint16_t)len);
+    if (at->waitResponse(10000L, GF(GSM_NL "+FTPGET: 2,")) != 1) {
+      return -1;
+    }
+    size_t n = at->stream.readStringUntil('\n').toInt();
+    n = at->stream.readBytes(buf, TinyGsmMin(n, len));
+    at->waitResponse();
+    return n;
+  }
+
+  // Waits for the next +FTPGET/+FTPPUT URC
+  bool waitEvent() {
+    uint32_t startMillis = millis();
+    while (!ready && !done && millis() - startMillis < timeout_ms) {
+      at->waitResponse(100, NULL, NULL);
+    }
+    return ready || done;
+  }
+
+  TinyGsmSim800*  at;
+  uint32_t        timeout_ms;
+  bool            ready;
+  bool            done;
+  int             error;
+  uint16_t        put_max;
 };
 
 
@@ -213,6 +902,22 @@ public:
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    memset(udps, 0, sizeof(udps));
+    hex_send = false;
+    memset(send_max, 0, sizeof(send_max));
+    server_session = NULL;
+    http_session = NULL;
+    ftp_session = NULL;
+    sms_ref = 0;
+    phonebook_index = NULL;
+    resetSettingsState();
+    sms_queue_len = 0;
+    sms_callback = NULL;
+    sms_entry = NULL;
+    sms_arg = NULL;
+#if defined(TINY_GSM_SMS_DIRECT)
+    sms_direct = false;
+#endif
   }
 
   virtual ~TinyGsmSim800() {}
@@ -231,12 +936,14 @@ public:
     if (!testAT()) {
       return false;
     }
+    resetSettingsState();
     sendAT(GF("&FZ"));  // Factory + Reset
     waitResponse();
     sendAT(GF("E0"));   // Echo Off
     if (waitResponse() != 1) {
       return false;
     }
+    changeSmsFormat(0);  // SMS in PDU mode, see TinyGsmPdu.h
 
     DBG(GF("### Modem:"), getModemName());
 
@@ -285,6 +992,7 @@ TINY_GSM_MODEM_TEST_AT()
 TINY_GSM_MODEM_MAINTAIN_CHECK_SOCKS()
 
   bool factoryDefault() {
+    resetSettingsState();
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
     sendAT(GF("+IPR=0"));   // Auto-baud
@@ -350,6 +1058,7 @@ TINY_GSM_MODEM_GET_INFO_ATI()
   }
 
   bool poweroff() {
+    resetSettingsState();
     sendAT(GF("+CPOWD=1"));
     return waitResponse(10000L, GF("NORMAL POWER DOWN")) == 1;
   }
@@ -492,6 +1201,15 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
       return false;
     }
 
+#ifdef TINY_GSM_USE_HEX
+    // Take CIPSEND data as hex digits, older firmware doesn't know it
+    sendAT(GF("+CIPSENDHEX=1"));
+    hex_send = waitResponse() == 1;
+    if (!hex_send) {
+      DBG("### CIPSENDHEX not supported, sending binary");
+    }
+#endif
+
     // Start Task and Set APN, USER NAME, PASSWORD
     sendAT(GF("+CSTT=\""), apn, GF("\",\""), user, GF("\",\""), pwd, GF("\""));
     if (waitResponse(60000L) != 1) {
@@ -650,10 +1368,7 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
    */
 
   String sendUSSD(const String& code) {
-    sendAT(GF("+CMGF=1"));
-    waitResponse();
-    sendAT(GF("+CSCS=\"HEX\""));
-    waitResponse();
+    changeCharacterSet(GF("HEX"));
     sendAT(GF("+CUSD=1,\""), code, GF("\""));
     if (waitResponse() != 1) {
       return "";
@@ -676,209 +1391,64 @@ TINY_GSM_MODEM_WAIT_FOR_NETWORK()
   }
 
   bool sendSMS(const String& number, const String& text) {
-    sendAT(GF("+CMGF=1"));
-    waitResponse();
-    //Set GSM 7 bit default alphabet (3GPP TS 23.038)
-    sendAT(GF("+CSCS=\"GSM\""));
-    waitResponse();
-    sendAT(GF("+CMGS=\""), number, GF("\""));
-    if (waitResponse(GF(">")) != 1) {
-      return false;
-    }
-    stream.print(text);
-    stream.write((char)0x1A);
-    stream.flush();
-    return waitResponse(60000L) == 1;
+    char pdu[TINY_GSM_PDU_BUFFER];
+    size_t len = TinyGsmPduEncodeSubmit(pdu, sizeof(pdu), number.c_str(),
+                                        text.c_str(), text.length(),
+                                        SmsAlphabet::GSM_7bit);
+    return len && sendSmsPdu(pdu, len);
   }
 
   bool sendSMS_UTF16(const String& number, const void* text, size_t len) {
-    sendAT(GF("+CMGF=1"));
-    waitResponse();
-    sendAT(GF("+CSCS=\"HEX\""));
-    waitResponse();
-    sendAT(GF("+CSMP=17,167,0,8"));
-    waitResponse();
-
-    sendAT(GF("+CMGS=\""), number, GF("\""));
-    if (waitResponse(GF(">")) != 1) {
-      return false;
-    }
-
-    uint16_t* t = (uint16_t*)text;
-    for (size_t i=0; i<len; i++) {
-      uint8_t c = t[i] >> 8;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-      c = t[i] & 0xFF;
-      if (c < 0x10) { stream.print('0'); }
-      stream.print(c, HEX);
-    }
-    stream.write((char)0x1A);
-    stream.flush();
-    return waitResponse(60000L) == 1;
+    char pdu[TINY_GSM_PDU_BUFFER];
+    size_t tpdu_len = TinyGsmPduEncodeSubmit(pdu, sizeof(pdu), number.c_str(),
+                                             text, len, SmsAlphabet::UCS2);
+    return tpdu_len && sendSmsPdu(pdu, tpdu_len);
   }
 
-/*
-Sms readSmsMessage(const uint8_t index, const bool changeStatusToRead = true) {
-    sendAT(GF("+CMGR="), index, GF(","), static_cast<const uint8_t>(!changeStatusToRead)); // Read SMS Message
-    if (waitResponse(5000L, GF(GSM_NL "+CMGR: \"")) != 1) {
-      stream.readString();
-      return {};
-    }
-//work
-
-    Sms sms;
-
-    // AT reply:
-    // <stat>,<oa>[,<alpha>],<scts>[,<tooa>,<fo>,<pid>,<dcs>,<sca>,<tosca>,<length>]<CR><LF><data>
-
-    //<stat>
-    const String res = stream.readStringUntil('"');
-    if (res == GF("REC READ")) {
-      sms.status = SmsStatus::REC_READ;
-    } else if (res == GF("REC UNREAD")) {
-      sms.status = SmsStatus::REC_UNREAD;
-    } else if (res == GF("STO UNSENT")) {
-      sms.status = SmsStatus::STO_UNSENT;
-    } else if (res == GF("STO SENT")) {
-      sms.status = SmsStatus::STO_SENT;
-    } else if (res == GF("ALL")) {
-      sms.status = SmsStatus::ALL;
-    } else {
-      stream.readString();
-      return {};
-    }
-
-    // <oa>
-    streamSkipUntil('"');
-    sms.originatingAddress = stream.readStringUntil('"');
-
-    // <alpha>
-    streamSkipUntil('"');
-    sms.phoneBookEntry = stream.readStringUntil('"');
-
-    // <scts>
-    streamSkipUntil('"');
-    sms.serviceCentreTimeStamp = stream.readStringUntil('"');
-    streamSkipUntil(',');
-
-    streamSkipUntil(','); // <tooa>
-    streamSkipUntil(','); // <fo>
-    streamSkipUntil(','); // <pid>
-
-    // <dcs>
-    const uint8_t alphabet = (stream.readStringUntil(',').toInt() >> 2) & B11;
-    switch (alphabet) {
-    case B00:
-      sms.alphabet = SmsAlphabet::GSM_7bit;
-      break;
-    case B01:
-      sms.alphabet = SmsAlphabet::Data_8bit;
-      break;
-    case B10:
-      sms.alphabet = SmsAlphabet::UCS2;
-      break;
-    case B11:
-    default:
-      sms.alphabet = SmsAlphabet::Reserved;
-      break;
-    }
-
-    streamSkipUntil(','); // <sca>
-    streamSkipUntil(','); // <tosca>
-
-    // <length>, CR, LF
-    const long length = stream.readStringUntil('\n').toInt();
-
-    // <data>
-    String data = stream.readString();
-    data.remove(static_cast<const unsigned int>(length));
-    switch (sms.alphabet) {
-    case SmsAlphabet::GSM_7bit:
-      sms.message = data;
-      break;
-    case SmsAlphabet::Data_8bit:
-      sms.message = TinyGsmDecodeHex8bit(data);
-      break;
-    case SmsAlphabet::UCS2:
-      sms.message = TinyGsmDecodeHex16bit(data);
-      break;
-    case SmsAlphabet::Reserved:
-      return {};
-    }
-
-    return sms;
+  /*
+   * Sends text of any length. Longer texts go out as a concatenated message
+   * of up to 255 parts (153 septets, or 67 UTF-16 units, each).
+   * AT+CMMS=1 keeps the link to the service centre open between the parts,
+   * and each CMGS is issued as soon as the previous one is confirmed.
+   */
+  bool sendLongSMS(const String& number, const String& text) {
+    return sendSmsConcatenated(number.c_str(), text.c_str(), text.length(),
+                               SmsAlphabet::GSM_7bit);
   }
 
-*/
-
+  bool sendLongSMS_UTF16(const String& number, const void* text, size_t len) {
+    return sendSmsConcatenated(number.c_str(), text, len, SmsAlphabet::UCS2);
+  }
 
-Sms readSmsMessage2(const uint8_t index, const bool changeStatusToRead = true) {
-  /*
-      +CMGR: "REC READ","+972509468305","ALEX","20/01/11,22:37:40+08"
-  */
-  
-    sendAT(GF("+CMGR="), index, GF(","), static_cast<const uint8_t>(!changeStatusToRead)); // Read SMS Message
-    if (waitResponse(5000L, GF(GSM_NL "+CMGR: \"")) != 1) {
-      stream.readString();
-      return {};
+  // Sends a PDU made by TinyGsmPduEncodeSubmit(), len is its return value
+  bool sendSmsPdu(const char* pdu, size_t len) {
+    sendAT(GF("+CMGS="), (uint16_t)len);
+    if (waitResponse(GF(">")) != 1) {
+      return false;
     }
+    stream.print(pdu);
+    stream.write((char)0x1A);
+    stream.flush();
+    return waitResponse(60000L) == 1;
+  }
 
-    Sms sms;
-
-
-/*
-
-at+cmgf=0
-OK
-
-at+cmgr=2
-+CMGR: 1,"",28
-0791795268721904040C917952906438500000021031108341800A31D98C56B3DD703918
-
-OK
-
-at+cmgf=1
-OK
-
-at+cmgr=2
-+CMGR: "REC READ","+972509468305","","20/01/13,01:38:14+08"
-1234567890
-
-
-*/
-
-
-    // AT reply:
-    // "REC READ","+972509468305","ALEX","20/01/11,22:37:40+08"
-
-    // <stat>,<oa>[,<alpha>],<scts>[,<tooa>,<fo>,<pid>,<dcs>,<sca>,<tosca>,<length>]<CR><LF><data>
-
-    //<stat>
-
-    const String res = stream.readStringUntil('"');
-    
-
-           if (res == (String) _statSMS.REC_READ) {
-      sms.status = SmsStatus::REC_READ;
-    } else if (res == (String) _statSMS.REC_UNREAD) {
-      sms.status = SmsStatus::REC_UNREAD;
-    } else if (res == (String) _statSMS.STO_UNSENT) {
-      sms.status = SmsStatus::STO_UNSENT;
-    } else if (res == (String) _statSMS.STO_SENT) {
-      sms.status = SmsStatus::STO_SENT;
-    } else if (res == (String) _statSMS.ALL) {
-      sms.status = SmsStatus::ALL;
-    } else {
+/*
+Sms readSmsMessage(const uint8_t index, const bool changeStatusToRead = true) {
+    sendAT(GF("+CMGR="), index, GF(","), static_cast<const uint8_t>(!changeStatusToRead)); // Read SMS Message
+    if (waitResponse(5000L, GF(GSM_NL "+CMGR: \"")) != 1) {
       stream.readString();
       return {};
     }
+//work
 
+    Sms sms;
 
+    // AT reply:
+    // <stat>,<oa>[,<alpha>],<scts>[,<tooa>,<fo>,<pid>,<dcs>,<sca>,<tosca>,<length>]<CR><LF><data>
 
-
-/*
-      if (res == GF("REC READ")) {
+    //<stat>
+    const String res = stream.readStringUntil('"');
+    if (res == GF("REC READ")) {
       sms.status = SmsStatus::REC_READ;
     } else if (res == GF("REC UNREAD")) {
       sms.status = SmsStatus::REC_UNREAD;
@@ -893,41 +1463,17 @@ at+cmgr=2
       return {};
     }
 
-*/
-
-
-    // Debug for internal use
-    SerialMon.print("restype:");
-    SerialMon.println(res);
-
-
-
-    // <oa> //phone sms sender
+    // <oa>
     streamSkipUntil('"');
     sms.originatingAddress = stream.readStringUntil('"');
 
-    SerialMon.print("ResPhone:");
-    SerialMon.println(sms.originatingAddress);
-// restype:REC READ
-// resphone:+972509468305
-
-// +CMGR: "REC READ","+972509468305","","20/01/13,01:38:14+08"
-
-    // <alpha>  
+    // <alpha>
     streamSkipUntil('"');
     sms.phoneBookEntry = stream.readStringUntil('"');
 
-    SerialMon.print("phoneBookEntry:");
-    SerialMon.println(sms.phoneBookEntry);
-
     // <scts>
     streamSkipUntil('"');
     sms.serviceCentreTimeStamp = stream.readStringUntil('"');
-
-    SerialMon.print("serviceCentreTimeStamp:");
-    SerialMon.println(sms.phoneBookEntry);
-
-
     streamSkipUntil(',');
 
     streamSkipUntil(','); // <tooa>
@@ -939,40 +1485,27 @@ at+cmgr=2
     switch (alphabet) {
     case B00:
       sms.alphabet = SmsAlphabet::GSM_7bit;
-      DBG("A:7bit");
       break;
     case B01:
       sms.alphabet = SmsAlphabet::Data_8bit;
-      DBG("A:8bit");
       break;
     case B10:
       sms.alphabet = SmsAlphabet::UCS2;
-      DBG("A:UCS2");
       break;
     case B11:
-      default:
+    default:
       sms.alphabet = SmsAlphabet::Reserved;
-      DBG("A:Reserver");
       break;
     }
 
-
     streamSkipUntil(','); // <sca>
     streamSkipUntil(','); // <tosca>
 
     // <length>, CR, LF
     const long length = stream.readStringUntil('\n').toInt();
-    DBG("Length",length);
-
-
 
     // <data>
     String data = stream.readString();
-
-    SerialMon.print("data:");
-    SerialMon.println(data);
-
-
     data.remove(static_cast<const unsigned int>(length));
     switch (sms.alphabet) {
     case SmsAlphabet::GSM_7bit:
@@ -991,6 +1524,91 @@ at+cmgr=2
     return sms;
   }
 
+*/
+
+
+  Sms readSmsMessage2(const uint8_t index, const bool changeStatusToRead = true) {
+    sendAT(GF("+CMGR="), index, GF(","), static_cast<const uint8_t>(!changeStatusToRead)); // Read SMS Message
+    if (waitResponse(5000L, GF(GSM_NL "+CMGR: ")) != 1) {
+      stream.readString();
+      return {};
+    }
+
+    // AT reply (PDU mode):
+    // <stat>,[<alpha>],<length><CR><LF><pdu>
+
+    Sms sms;
+    sms.status = static_cast<SmsStatus>(stream.readStringUntil(',').toInt());
+    sms.phoneBookEntry = stream.readStringUntil(',');
+    sms.phoneBookEntry.replace("\"", "");
+    streamSkipUntil('\n'); // <length>
+
+    // 160 septets as UTF-8 (up to 3 bytes each), or 140 raw octets
+    uint8_t data[160 * 3 + 1];
+    TinyGsmSmsPdu pdu;
+    pdu.data = data;
+    pdu.data_size = sizeof(data);
+    TinyGsmPduReader reader(stream);
+    bool ok = TinyGsmPduDecode(reader, pdu);
+    waitResponse();
+    if (!ok) {
+      DBG("### Unsupported SMS PDU at", index);
+      return {};
+    }
+
+    sms.alphabet = pdu.alphabet;
+    sms.originatingAddress = pdu.sender;
+    sms.serviceCentreTimeStamp = pdu.timestamp;
+    sms.message.reserve(pdu.length);
+    if (pdu.alphabet == SmsAlphabet::UCS2) {
+      char text[TINY_GSM_PDU_UD_MAX / 2 * 3 + 1];  // 3 bytes per unit at most
+      size_t len = TinyGsmUtf16ToUtf8(data, pdu.length, text, sizeof(text) - 1);
+      text[len] = '\0';
+      sms.message = text;
+    } else {
+      for (size_t i = 0; i < pdu.length; i++) {
+        sms.message += (char)data[i];
+      }
+    }
+    return sms;
+  }
+
+  /*
+   * Lists the stored messages with the given status in one AT+CMGL and
+   * calls back once per message. Each PDU is decoded straight from the
+   * stream into the caller's entry, which is reused for the next one.
+   * Returns the number of messages, or -1 on error.
+   */
+  int listSmsMessages(SmsStatus status, SmsCallback callback, SmsEntry& sms,
+                      void* arg = NULL, const bool changeStatusToRead = true) {
+    sendAT(GF("+CMGL="), static_cast<const uint8_t>(status), ',',
+           static_cast<const uint8_t>(!changeStatusToRead));
+
+    int count = 0;
+    for (;;) {
+      // Entries follow each other directly, the final result has a blank
+      // line before it, so an "OK" inside a line never ends the listing
+      int rsp = waitResponse(20000L, GF("+CMGL: "), GF(GSM_NL "OK" GSM_NL),
+                             GF(GSM_NL "ERROR" GSM_NL), GF("+CMS ERROR:"));
+      if (rsp == 2) {
+        return count;
+      } else if (rsp != 1) {
+        return -1;
+      }
+
+      // <index>,<stat>,[<alpha>],<length><CR><LF><pdu>
+      sms.index = stream.readStringUntil(',').toInt();
+      sms.status = static_cast<SmsStatus>(stream.readStringUntil(',').toInt());
+      streamSkipUntil('\n');
+      readSmsPdu(sms);
+
+      if (callback) {
+        callback(sms, arg);
+      }
+      count++;
+    }
+  }
+
   MessageStorage getPreferredMessageStorage() {
     sendAT(GF("+CPMS?")); // Preferred SMS Message Storage
     if (waitResponse(GF(GSM_NL "+CPMS:")) != 1) {
@@ -1070,30 +1688,108 @@ at+cmgr=2
   }
 
   bool deleteAllSmsMessages(const DeleteAllSmsMethod method) {
-    // Select SMS Message Format: PDU mode. Spares us space now
-    sendAT(GF("+CMGF=0"));
-    if (waitResponse() != 1) {
-        return false;
-    }
-
+    // Numeric <type> as the modem stays in PDU mode
     sendAT(GF("+CMGDA="), static_cast<const uint8_t>(method)); // Delete All SMS
-    const bool ok = waitResponse(25000L) == 1;
-
-    sendAT(GF("+CMGF=1"));
-    waitResponse();
-
-    return ok;
+    return waitResponse(25000L) == 1;
   }
 
-  bool receiveNewMessageIndication(const bool enabled = true, const bool cbmIndication = false, const bool statusReport = false) {
+  // With direct set, new messages aren't stored but passed on with +CMT
+  // direct (+CMT) needs TINY_GSM_SMS_DIRECT, the messages are not stored
+  bool receiveNewMessageIndication(const bool enabled = true, const bool cbmIndication = false,
+                                   const bool statusReport = false, const bool direct = false) {
+#if !defined(TINY_GSM_SMS_DIRECT)
+    if (enabled && direct) {
+      DBG("### Define TINY_GSM_SMS_DIRECT for +CMT");
+      return false;
+    }
+#endif
     sendAT(GF("+CNMI=2,"),           // New SMS Message Indications
-           enabled, GF(","),         // format: +CMTI: <mem>,<index>
+           enabled ? (direct ? 2 : 1) : 0, GF(","),  // format: +CMTI: <mem>,<index> or +CMT: [<alpha>],<length><CR><LF><pdu>
            cbmIndication, GF(","),   // format: +CBM: <sn>,<mid>,<dcs>,<page>,<pages><CR><LF><data>
            statusReport, GF(",0"));  // format: +CDS: <fo>,<mr>[,<ra>][,<tora>],<scts>,<dt>,<st>
 
     return waitResponse() == 1;
   }
 
+  /*
+   * Messages announced by +CMTI are queued by index (up to
+   * TINY_GSM_SMS_QUEUE) whenever URCs are processed, e.g. by maintain(),
+   * so there's no need to poll the storage.
+   */
+  uint8_t newSmsCount() const {
+    return sms_queue_len;
+  }
+
+  // Takes the next index announced by +CMTI, -1 if there is none
+  int getNewSmsIndex() {
+    if (!sms_queue_len) {
+      return -1;
+    }
+    uint8_t index = sms_queue[0];
+    memmove(sms_queue, sms_queue + 1, --sms_queue_len);
+    return index;
+  }
+
+  /*
+   * Hands new messages to callback from handleNewSms(), in the caller's
+   * entry. Stored ones (+CMTI) are read and then deleted from storage.
+   * Directly delivered ones (+CMT, with TINY_GSM_SMS_DIRECT) are decoded
+   * into a slot of the modem as they arrive, and copied to the entry with
+   * index 0 when handled; one that arrives before the previous one was
+   * handled replaces it.
+   */
+  void onNewSms(SmsCallback callback, SmsEntry& sms, void* arg = NULL) {
+    sms_callback = callback;
+    sms_entry = &sms;
+    sms_arg = arg;
+  }
+
+  // Processes URCs and delivers new messages, call from loop()
+  void handleNewSms() {
+    while (stream.available()) {
+      waitResponse(15, NULL, NULL);
+    }
+    if (!sms_callback) {
+      return;
+    }
+    // A +CMT may come in while a stored message is read, check again
+    for (;;) {
+#if defined(TINY_GSM_SMS_DIRECT)
+      if (sms_direct) {
+        sms_direct = false;
+        *sms_entry = sms_cmt;
+        sms_callback(*sms_entry, sms_arg);
+        continue;
+      }
+#endif
+      int index = getNewSmsIndex();
+      if (index < 0) {
+        break;
+      }
+      if (readSmsEntry(index, *sms_entry)) {
+        sms_callback(*sms_entry, sms_arg);
+        deleteSmsMessage(index);
+      }
+    }
+  }
+
+  // Reads one stored message into the caller's entry
+  bool readSmsEntry(const uint8_t index, SmsEntry& sms, const bool changeStatusToRead = true) {
+    sendAT(GF("+CMGR="), index, GF(","), static_cast<const uint8_t>(!changeStatusToRead));
+    // Only OK for an empty index
+    if (waitResponse(5000L, GF("+CMGR: "), GFP(GSM_OK), GFP(GSM_ERROR),
+                     GF("+CMS ERROR:")) != 1) {
+      return false;
+    }
+    // <stat>,[<alpha>],<length><CR><LF><pdu>
+    sms.index = index;
+    sms.status = static_cast<SmsStatus>(stream.readStringUntil(',').toInt());
+    streamSkipUntil('\n');
+    bool ok = readSmsPdu(sms);
+    waitResponse();
+    return ok;
+  }
+
 
 
 
@@ -1103,9 +1799,6 @@ int result;
 String MemoryStorage;
 int Total1;
 
-  sendAT(GF("+CMGF=1")); // set text mode sms
-  waitResponse();
-
  sendAT(GF("+CPMS?"));  //,"\"",stat,"\""); Preferred SMS Message Storage
 
   if (waitResponse(GF(GSM_NL "+CPMS: \"")) != 1) {
@@ -1183,7 +1876,13 @@ DBG("Total1:",Total1);
     // AT+CPBW=<index>[,<number>,[<type>,[<text>]]]
     sendAT(GF("+CPBW=,\""), number, GF("\",145,\""), text, '"');  // Write Phonebook Entry
 
-    return waitResponse(3000L) == 1;
+    if (waitResponse(3000L) != 1) {
+      return false;
+    }
+    if (phonebook_index) {
+      loadPhonebook(*phonebook_index);
+    }
+    return true;
   }
 
   bool deletePhonebookEntry(const uint8_t index) {
@@ -1191,7 +1890,66 @@ DBG("Total1:",Total1);
     sendAT(GF("+CPBW="), index); // Write Phonebook Entry
 
     // Returns OK even if an empty index is deleted in the valid range
-    return waitResponse(3000L) == 1;
+    if (waitResponse(3000L) != 1) {
+      return false;
+    }
+    if (phonebook_index) {
+      loadPhonebook(*phonebook_index);
+    }
+    return true;
+  }
+
+  /*
+   * Reads every number of the current phonebook storage with a single
+   * AT+CPBR=1,<total> into index, for local lookups such as
+   *
+   *   if (phonebook.find(callerNumber)) { ... }
+   *
+   * The modem keeps a pointer to index and reloads it after
+   * addPhonebookEntry() and deletePhonebookEntry(), until unloadPhonebook().
+   * Returns the number of entries, -1 on error.
+   */
+  int loadPhonebook(TinyGsmPhonebookIndex& index) {
+    phonebook_index = &index;
+    index.clear();
+
+    PhonebookStorage storage = getPhonebookStorage();
+    if (storage.type == PhonebookStorageType::Invalid) {
+      return -1;
+    }
+    if (!storage.used) {
+      return 0;
+    }
+
+    changeCharacterSet(GF("GSM"));
+    sendAT(GF("+CPBR=1,"), storage.total); // Read Current Phonebook Entries
+
+    // AT response:
+    // +CPBR: <index1>,<number>,<type>,<text>
+    // [...]
+    for (;;) {
+      int rsp = waitResponse(10000L, GF("+CPBR: "), GFP(GSM_OK), GFP(GSM_ERROR),
+                             GF("+CME ERROR:"));
+      if (rsp == 2) {
+        return index.size();
+      } else if (rsp != 1) {
+        return -1;
+      }
+      uint8_t i = stream.readStringUntil(',').toInt();
+      char number[24];
+      streamSkipUntil('"');
+      size_t len = stream.readBytesUntil('"', number, sizeof(number) - 1);
+      number[len] = '\0';
+      streamSkipUntil('\n');
+      if (!index.add(i, number)) {
+        DBG("### Phonebook entry not indexed:", i);
+      }
+    }
+  }
+
+  // Forgets the index given to loadPhonebook(), call before it goes away
+  void unloadPhonebook() {
+    phonebook_index = NULL;
   }
 
   PhonebookEntry readPhonebookEntry(const uint8_t index) {
@@ -1418,6 +2176,62 @@ DBG("Total1:",Total1);
 
 protected:
 
+  bool sendSmsConcatenated(const char* number, const void* text, size_t len,
+                           SmsAlphabet alphabet)
+  {
+    bool ucs2 = (alphabet == SmsAlphabet::UCS2);
+    char pdu[TINY_GSM_PDU_BUFFER];
+    size_t tpdu_len;
+
+    if (ucs2 ? len <= 70 : TinyGsmGsm7Length((const char*)text, len) <= 160) {
+      tpdu_len = TinyGsmPduEncodeSubmit(pdu, sizeof(pdu), number, text, len, alphabet);
+      return tpdu_len && sendSmsPdu(pdu, tpdu_len);
+    }
+
+    size_t parts = 0;
+    for (size_t pos = 0; pos < len; pos += smsPartLength(text, pos, len, ucs2)) {
+      parts++;
+    }
+    if (parts > 255) {
+      return false;
+    }
+
+    sendAT(GF("+CMMS=1"));  // Keep the link open until the last part is sent
+    waitResponse();
+
+    sms_ref++;
+    uint8_t seq = 1;
+    for (size_t pos = 0; pos < len; seq++) {
+      size_t n = smsPartLength(text, pos, len, ucs2);
+      const void* part = ucs2 ? (const void*)((const uint16_t*)text + pos)
+                              : (const void*)((const char*)text + pos);
+      tpdu_len = TinyGsmPduEncodeSubmit(pdu, sizeof(pdu), number, part, n,
+                                        alphabet, false, parts, seq, sms_ref);
+      if (!tpdu_len || !sendSmsPdu(pdu, tpdu_len)) {
+        DBG("### Long SMS failed at part", seq, "of", parts);
+        return false;
+      }
+      pos += n;
+    }
+    return true;
+  }
+
+  // Bytes (or UTF-16 units) of a message part starting at pos. A UTF-8
+  // sequence, escaped septet pair or surrogate pair is never split.
+  static size_t smsPartLength(const void* text, size_t pos, size_t len, bool ucs2) {
+    if (!ucs2) {
+      return TinyGsmGsm7Fit((const char*)text + pos, len - pos, 153);
+    }
+    size_t n = TinyGsmMin(len - pos, (size_t)67);
+    if (n < len - pos) {
+      uint16_t last = ((const uint16_t*)text)[pos + n - 1];
+      if (last >= 0xD800 && last < 0xDC00) {
+        n--;
+      }
+    }
+    return n;
+  }
+
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
                     bool ssl = false, int timeout_s = 75)
  {
@@ -1430,6 +2244,7 @@ protected:
       return false;
     }
 #endif
+    send_max[mux] = 0;
     sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
     rsp = waitResponse(timeout_ms,
                        GF("CONNECT OK" GSM_NL),
@@ -1441,18 +2256,68 @@ protected:
     return (1 == rsp);
   }
 
-  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
-    if (waitResponse(GF(">")) != 1) {
-      return 0;
+  // Only waits for the command to be accepted, the outcome is reported
+  // later as "<mux>, CONNECT OK" or "<mux>, CONNECT FAIL"
+  bool modemConnectAsync(const char* host, uint16_t port, uint8_t mux,
+                         bool ssl = false)
+  {
+#if !defined(TINY_GSM_MODEM_SIM900)
+    sendAT(GF("+CIPSSL="), ssl);
+    if (waitResponse() != 1 && ssl) {
+      return false;
     }
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) {
-      return 0;
+#endif
+    send_max[mux] = 0;
+    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
+    return waitResponse() == 1;
+  }
+
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most modemSendMax() bytes. In quick
+  // send mode (CIPQSEND=1) each one is confirmed as soon as the modem has
+  // buffered it, so the fragments go out back to back.
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)modemSendMax(mux));
+      sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF(">")) != 1) {
+        break;
+      }
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk, hex_send);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) {
+        break;
+      }
+      streamSkipUntil(','); // Skip mux
+      size_t accepted = stream.readStringUntil('\n').toInt();
+      sent += accepted;
+      if (accepted != chunk) {
+        break;
+      }
     }
-    streamSkipUntil(','); // Skip mux
-    return stream.readStringUntil('\n').toInt();
+    return sent;
+  }
+
+  // Largest single send on the connection, queried once per connection
+  uint16_t modemSendMax(uint8_t mux) {
+    if (send_max[mux]) {
+      return send_max[mux];
+    }
+    sendAT(GF("+CIPSEND?"));
+    while (waitResponse(GF("+CIPSEND:"), GFP(GSM_OK)) == 1) {
+      uint8_t n = stream.readStringUntil(',').toInt();
+      uint16_t size = stream.readStringUntil('\n').toInt();
+      if (n == mux) {
+        send_max[mux] = size;
+      }
+    }
+    return send_max[mux] ? send_max[mux] : TINY_GSM_SEND_MAX;
   }
 
   size_t modemRead(size_t size, uint8_t mux) {
@@ -1475,20 +2340,19 @@ protected:
     // ^^ Confirmed number of data bytes to be read, which may be less than requested.
     // 0 indicates that no data can be read.
     // This is actually be the number of bytes that will be remaining after the read
-    for (int i=0; i<len_requested; i++) {
-      uint32_t startMillis = millis();
 #ifdef TINY_GSM_USE_HEX
-      while (stream.available() < 2 && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
-      char buf[4] = { 0, };
-      buf[0] = stream.read();
-      buf[1] = stream.read();
-      char c = strtol(buf, NULL, 16);
+    if (TinyGsmReadHex(stream, sockets[mux]->rx, len_requested,
+                       sockets[mux]->_timeout) != (size_t)len_requested) {
+      DBG("### Bad HEX data from", mux);
+    }
 #else
+    for (int i=0; i<len_requested; i++) {
+      uint32_t startMillis = millis();
       while (!stream.available() && (millis() - startMillis < sockets[mux]->_timeout)) { TINY_GSM_YIELD(); }
       char c = stream.read();
-#endif
       sockets[mux]->rx.put(c);
     }
+#endif
     DBG("### READ:", len_requested, "from", mux);
     // sockets[mux]->sock_available = modemGetAvailable(mux);
     sockets[mux]->sock_available = len_confirmed;
@@ -1496,6 +2360,40 @@ protected:
     return len_requested;
   }
 
+  bool modemConnectUdp(const char* host, uint16_t port, uint16_t localPort,
+                       uint8_t mux)
+  {
+    if (localPort) {
+      sendAT(GF("+CLPORT="), mux, GF(",\"UDP\","), localPort);
+      waitResponse();
+    }
+    send_max[mux] = 0;
+    sendAT(GF("+CIPSTART="), mux, ',', GF("\"UDP"), GF("\",\""), host, GF("\","), port);
+    int rsp = waitResponse(75000L,
+                           GF("CONNECT OK" GSM_NL),
+                           GF("CONNECT FAIL" GSM_NL),
+                           GF("ALREADY CONNECT" GSM_NL),
+                           GF("ERROR" GSM_NL));
+    return (1 == rsp);
+  }
+
+  // Reads straight into the caller's buffer, always in binary mode
+  size_t modemReadUdp(uint8_t* buf, size_t size, uint8_t mux) {
+    sendAT(GF("+CIPRXGET=2,"), mux, ',', (uint16_t)size);
+    if (waitResponse(GF("+CIPRXGET:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(','); // Skip mode 2
+    streamSkipUntil(','); // Skip mux
+    int len_requested = stream.readStringUntil(',').toInt();
+    int len_remaining = stream.readStringUntil('\n').toInt();
+    size_t len = stream.readBytes(buf, len_requested);
+    udps[mux]->got_data = len_remaining > 0;
+    DBG("### READ:", len, "from", mux);
+    waitResponse();
+    return len;
+  }
+
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
@@ -1549,6 +2447,38 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
         data += (char)a;
+        if (data.endsWith(GF("CLOSE OK" GSM_NL))) {
+          // Answer to a stopAsync(), must not be taken for our own "OK"
+          int nl = data.lastIndexOf(GSM_NL, data.length()-10);
+          int coma = data.indexOf(',', nl+2);
+          int mux = data.substring(nl+2, coma).toInt();
+          if (coma > 0 && mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
+              sockets[mux]->sock_closing) {
+            sockets[mux]->sock_closing = false;
+            data = "";
+            DBG("### Closed async:", mux);
+            continue;
+          }
+        }
+        if (data.endsWith(GF("CONNECT OK" GSM_NL)) ||
+            data.endsWith(GF("CONNECT FAIL" GSM_NL)) ||
+            data.endsWith(GF("ALREADY CONNECT" GSM_NL))) {
+          // Outcome of a connectAsync(), must not be taken for our own "OK".
+          // A blocking connect leaves sock_connecting clear and gets it in r1/r2.
+          bool ok = !data.endsWith(GF("CONNECT FAIL" GSM_NL));
+          // The line starts after the previous LF, or at the start of data
+          int start = data.lastIndexOf('\n', data.length() - 2) + 1;
+          int coma = data.indexOf(',', start);
+          int mux = data.substring(start, coma).toInt();
+          if (coma > start && mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
+              sockets[mux]->sock_connecting) {
+            sockets[mux]->sock_connected = ok;
+            sockets[mux]->sock_connecting = false;
+            data = "";
+            DBG("### Connect:", ok, "on", mux);
+            continue;
+          }
+        }
         if (r1 && data.endsWith(r1)) {
           index = 1;
           goto finish;
@@ -1570,6 +2500,8 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
             int mux = stream.readStringUntil('\n').toInt();
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
               sockets[mux]->got_data = true;
+            } else if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && udps[mux]) {
+              udps[mux]->got_data = true;
             }
             data = "";
             DBG("### Got Data:", mux);
@@ -1594,6 +2526,80 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           }
           data = "";
           DBG("### Closed: ", mux);
+        } else if (data.endsWith(GF(", REMOTE IP:"))) {
+          // "<mux>, REMOTE IP: <ip>" for a connection to our server
+          int nl = data.lastIndexOf('\n', data.length() - 12);
+          int mux = data.substring(nl + 1).toInt();
+          streamSkipUntil('\n');
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && server_session) {
+            server_session->pending |= (1 << mux);
+          }
+          data = "";
+          DBG("### Incoming:", mux);
+        } else if (data.endsWith(GF(GSM_NL "+HTTPACTION:"))) {
+          streamSkipUntil(','); // Skip method
+          int status = stream.readStringUntil(',').toInt();
+          uint32_t len = stream.readStringUntil('\n').toInt();
+          if (http_session) {
+            http_session->status = status;
+            http_session->content_length = len;
+            http_session->pending = false;
+          }
+          data = "";
+          DBG("### HTTP action:", status, len);
+        } else if (data.endsWith(GF(GSM_NL "+FTPGET: 1,")) ||
+                   data.endsWith(GF(GSM_NL "+FTPPUT: 1,"))) {
+          // "1,1[,<max len>]" ready for the next block, "1,0" finished,
+          // anything else is an FTP error code
+          String res = stream.readStringUntil('\n');
+          int code = res.toInt();
+          if (ftp_session) {
+            if (code == 1) {
+              int coma = res.indexOf(',');
+              if (coma > 0) {
+                ftp_session->put_max = TinyGsmMin(res.substring(coma + 1).toInt(),
+                                                  (long)TINY_GSM_FTP_BLOCK);
+              }
+              ftp_session->ready = true;
+            } else {
+              ftp_session->error = code;
+              ftp_session->done = true;
+            }
+          }
+          data = "";
+          DBG("### FTP:", code);
+        } else if (data.endsWith(GF(GSM_NL "+CMTI:"))) {
+          streamSkipUntil(','); // Skip <mem>
+          uint8_t index = stream.readStringUntil('\n').toInt();
+          if (!memchr(sms_queue, index, sms_queue_len)) {
+            if (sms_queue_len < TINY_GSM_SMS_QUEUE) {
+              sms_queue[sms_queue_len++] = index;
+            } else {
+              DBG("### SMS queue full, dropped:", index);
+            }
+          }
+          data = "";
+          DBG("### New SMS:", index);
+        } else if (data.endsWith(GF(GSM_NL "+CMT:"))) {
+          // [<alpha>],<length><CR><LF><pdu>
+          streamSkipUntil('\n');
+#if defined(TINY_GSM_SMS_DIRECT)
+          if (sms_callback) {
+            if (sms_direct) {
+              DBG("### SMS replaced before it was handled");
+            }
+            // Not into the caller's entry, a CMGR may be filling it right now
+            sms_cmt.index = 0;
+            sms_cmt.status = SmsStatus::REC_UNREAD;
+            sms_direct = readSmsPdu(sms_cmt);
+          } else {
+            streamSkipUntil('\n');
+          }
+#else
+          streamSkipUntil('\n');
+#endif
+          data = "";
+          DBG("### SMS delivered");
         }
       }
     } while (millis() - startMillis < timeout_ms);
@@ -1633,10 +2639,83 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  GsmUdp*       udps[TINY_GSM_MUX_COUNT];
+  uint16_t      send_max[TINY_GSM_MUX_COUNT];
+  bool          hex_send;   // CIPSEND takes hex digits (CIPSENDHEX=1)
+  GsmServer*    server_session;
+  Http*         http_session;
+  Ftp*          ftp_session;
+  uint8_t       sms_ref;    // Reference of the last concatenated SMS
+  TinyGsmPhonebookIndex* phonebook_index;  // Reloaded after phonebook changes
+  char          charset[8];   // Last AT+CSCS set, empty if unknown
+  int8_t        sms_format;   // Last AT+CMGF set, -1 if unknown
+  uint8_t       sms_queue[TINY_GSM_SMS_QUEUE];
+  uint8_t       sms_queue_len;
+  SmsCallback   sms_callback;
+  SmsEntry*     sms_entry;
+  void*         sms_arg;
+#if defined(TINY_GSM_SMS_DIRECT)
+  bool          sms_direct;   // A +CMT message waits in sms_cmt
+  SmsEntry      sms_cmt;
+#endif
+
+  // Decodes a PDU line from the stream into sms, after its header line
+  bool readSmsPdu(SmsEntry& sms) {
+    TinyGsmSmsPdu pdu;
+    pdu.data = (uint8_t*)sms.text;
+    pdu.data_size = sizeof(sms.text) - 1;
+    TinyGsmPduReader reader(stream);
+    bool ok = TinyGsmPduDecode(reader, pdu);
+    if (ok) {
+      sms.alphabet = pdu.alphabet;
+      strcpy(sms.sender, pdu.sender);
+      strcpy(sms.timestamp, pdu.timestamp);
+      sms.length = pdu.length;
+    } else {
+      DBG("### Unsupported SMS PDU at", sms.index);
+      sms.alphabet = SmsAlphabet::Reserved;
+      sms.sender[0] = '\0';
+      sms.timestamp[0] = '\0';
+      sms.length = 0;
+    }
+    sms.text[sms.length] = '\0';
+    streamSkipUntil('\n'); // Rest of the PDU line
+    return ok;
+  }
+
+  // Forgets the tracked settings, for when the modem may have reset them
+  void resetSettingsState() {
+    charset[0] = '\0';
+    sms_format = -1;
+  }
 
+  // Only sends AT+CSCS if the character set differs from the last one set
   bool changeCharacterSet(const String &alphabet) {
+    if (charset[0] && alphabet == charset) {
+      return true;
+    }
     sendAT(GF("+CSCS=\""), alphabet, '"');
-    return waitResponse() == 1;
+    bool ok = waitResponse() == 1;
+    if (ok && alphabet.length() < sizeof(charset)) {
+      strcpy(charset, alphabet.c_str());
+    } else {
+      charset[0] = '\0';
+    }
+    return ok;
+  }
+
+  // Only sends AT+CMGF if the format differs from the last one set
+  bool changeSmsFormat(uint8_t format) {
+    if (sms_format == format) {
+      return true;
+    }
+    sendAT(GF("+CMGF="), format);
+    if (waitResponse() != 1) {
+      sms_format = -1;
+      return false;
+    }
+    sms_format = format;
+    return true;
   }
 
 };
@@ -18,7 +18,11 @@
 
 #define TINY_GSM_MUX_COUNT 7
 
+// Largest single binary USOWR
+#define TINY_GSM_SEND_MAX 1024
+
 #include <TinyGsmCommon.h>
+#include <TinyGsmUdp.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -164,12 +168,31 @@ public:
 };
 
 
+/*
+ * UDP on a USOCR=17 socket, see TinyGsmUdpSocket
+ */
+class GsmUdp : public TinyGsmUdpSocket<TinyGsmSaraR4>
+{
+  friend class TinyGsmSaraR4;
+
+public:
+  GsmUdp() {}
+
+  GsmUdp(TinyGsmSaraR4& modem) {
+    init(&modem);
+  }
+};
+
+friend class TinyGsmUdpSocket<TinyGsmSaraR4>;
+
+
 public:
 
   TinyGsmSaraR4(Stream& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    memset(udps, 0, sizeof(udps));
   }
 
   virtual ~TinyGsmSaraR4(){}
@@ -596,21 +619,36 @@ protected:
     // return (1 == rsp);
   }
 
-  int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+USOWR="), mux, ',', (uint16_t)len);
-    if (waitResponse(GF("@")) != 1) {
-      return 0;
-    }
-    // 50ms delay, see AT manual section 25.10.4
-    delay(50);
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) {
-      return 0;
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into binary writes of at most TINY_GSM_SEND_MAX bytes
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+USOWR="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF("@")) != 1) {
+        break;
+      }
+      // 50ms delay, see AT manual section 25.10.4
+      delay(50);
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) {
+        break;
+      }
+      streamSkipUntil(','); // Skip mux
+      size_t written = stream.readStringUntil('\n').toInt();
+      waitResponse();  // sends back OK after the confirmation of number sent
+      sent += written;
+      if (written != chunk) {
+        break;
+      }
     }
-    streamSkipUntil(',');  // Skip mux
-    int sent = stream.readStringUntil('\n').toInt();
-    waitResponse();  // sends back OK after the confirmation of number sent
     return sent;
   }
 
@@ -633,6 +671,79 @@ protected:
     return len;
   }
 
+  bool modemOpenUdp(uint16_t localPort, uint8_t* mux, GsmUdp* udp) {
+    if (localPort) {
+      sendAT(GF("+USOCR=17,"), localPort);
+    } else {
+      sendAT(GF("+USOCR=17"));
+    }
+    if (waitResponse(GF(GSM_NL "+USOCR:")) != 1) {
+      return false;
+    }
+    *mux = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    if (*mux >= TINY_GSM_MUX_COUNT) {
+      return false;
+    }
+    // A TCP client may still point at this id from an earlier connection
+    sockets[*mux] = NULL;
+    udps[*mux] = udp;
+    return true;
+  }
+
+  size_t modemSendTo(const char* host, uint16_t port, const void* buff,
+                     size_t len, uint8_t mux) {
+    // USOST only takes an IP address
+    String ip = host;
+    IPAddress tmp;
+    if (!TinyGsmUdp::parseIp(ip, tmp)) {
+      sendAT(GF("+UDNSRN=0,\""), host, GF("\""));
+      if (waitResponse(70000L, GF(GSM_NL "+UDNSRN:")) != 1) {
+        return 0;
+      }
+      streamSkipUntil('\"');
+      ip = stream.readStringUntil('\"');
+      waitResponse();
+    }
+    sendAT(GF("+USOST="), mux, GF(",\""), ip, GF("\","), port, ',', (uint16_t)len);
+    if (waitResponse(GF("@")) != 1) {
+      return 0;
+    }
+    // 50ms delay, see AT manual section 25.10.4
+    delay(50);
+    stream.write((uint8_t*)buff, len);
+    stream.flush();
+    if (waitResponse(GF(GSM_NL "+USOST:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(','); // Skip mux
+    size_t sent = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    return sent;
+  }
+
+  // +USORF: <mux>,"<ip>",<port>,<len>,"<data>"
+  // A datagram longer than size is cut off by the modem
+  size_t modemReadFrom(uint8_t* buf, size_t size, uint8_t mux,
+                       String& ip, uint16_t& port) {
+    sendAT(GF("+USORF="), mux, ',', (uint16_t)size);
+    if (waitResponse(GF(GSM_NL "+USORF:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(','); // Skip mux
+    streamSkipUntil('\"');
+    ip = stream.readStringUntil('\"');
+    streamSkipUntil(',');
+    port = stream.readStringUntil(',').toInt();
+    size_t len = stream.readStringUntil(',').toInt();
+    streamSkipUntil('\"');
+    len = stream.readBytes(buf, TinyGsmMin(len, size));
+    streamSkipUntil('\"');
+    waitResponse();
+    DBG("### READ:", len, "from", mux);
+    return len;
+  }
+
   size_t modemGetAvailable(uint8_t mux) {
     // NOTE:  Querying a closed socket gives an error "operation not allowed"
     sendAT(GF("+USORD="), mux, ",0");
@@ -735,6 +846,14 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           }
           data = "";
           DBG("### URC Data Received:", len, "on", mux);
+        } else if (data.endsWith(GF("+UUSORF:"))) {
+          int mux = stream.readStringUntil(',').toInt();
+          int len = stream.readStringUntil('\n').toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && udps[mux]) {
+            udps[mux]->sock_available = len;
+          }
+          data = "";
+          DBG("### URC Datagram Received:", len, "on", mux);
         } else if (data.endsWith(GF("+UUSOCL:"))) {
           int mux = stream.readStringUntil('\n').toInt();
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
@@ -779,6 +898,7 @@ public:
 
 protected:
   GsmClient* sockets[TINY_GSM_MUX_COUNT];
+  GsmUdp*    udps[TINY_GSM_MUX_COUNT];
 };
 
 #endif
@@ -17,6 +17,9 @@
 
 #define TINY_GSM_MUX_COUNT 6
 
+// Largest single SQNSSENDEXT
+#define TINY_GSM_SEND_MAX 1500
+
 #include <TinyGsmCommon.h>
 
 #define GSM_NL "\r\n"
@@ -175,12 +178,93 @@ public:
 
 };
 
+
+/*
+ * TCP server on an SQNSL listening socket. An incoming connection is
+ * announced by "+SQNSRING: <connId>" (without a length) and accept()
+ * takes it over with SQNSA, on the same connId: the socket stops
+ * listening, so call begin() again (on another connId while the first
+ * connection is open) to wait for the next one.
+ */
+class GsmServer
+{
+  friend class TinyGsmSequansMonarch;
+
+public:
+  GsmServer() {}
+
+  GsmServer(TinyGsmSequansMonarch& modem, uint8_t mux = TINY_GSM_MUX_COUNT) {
+    init(&modem, mux);
+  }
+
+  virtual ~GsmServer() {}
+
+  bool init(TinyGsmSequansMonarch* modem, uint8_t mux = TINY_GSM_MUX_COUNT) {
+    this->at = modem;
+    this->mux = mux;
+    pending = false;
+    listening = false;
+    return true;
+  }
+
+  bool begin(uint16_t port) {
+    at->server_session = this;
+    pending = false;
+    listening = at->modemListen(port, mux);
+    return listening;
+  }
+
+  // Binds the waiting connection to client.
+  // Returns false if nobody has connected meanwhile.
+  bool accept(GsmClient& client) {
+    at->maintain();
+    if (!pending) {
+      return false;
+    }
+    pending = false;
+    //AT+SQNSA=<connId>[,<connMode>], command mode like our own dials
+    at->sendAT(GF("+SQNSA="), mux, GF(",1"));
+    if (at->waitResponse(5000L) != 1) {
+      return false;
+    }
+    listening = false;
+    client.init(at, mux);
+    client.sock_connected = true;
+    // Data may have been announced before the client existed
+    client.got_data = true;
+    return true;
+  }
+
+  void stop() {
+    if (listening) {
+      at->sendAT(GF("+SQNSH="), mux);
+      at->waitResponse();
+    }
+    listening = false;
+    pending = false;
+    if (at->server_session == this) {
+      at->server_session = NULL;
+    }
+  }
+
+  operator bool() {
+    return listening;
+  }
+
+private:
+  TinyGsmSequansMonarch* at;
+  uint8_t         mux;
+  bool            pending;
+  bool            listening;
+};
+
 public:
 
   TinyGsmSequansMonarch(Stream& stream)
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    server_session = NULL;
   }
 
   virtual ~TinyGsmSequansMonarch() {}
@@ -578,21 +662,47 @@ protected:
   }
 
 
-  int modemSend(const void* buff, size_t len, uint8_t mux) {
+  bool modemListen(uint16_t port, uint8_t mux) {
+    // Same socket configuration as modemConnect()
+    sendAT(GF("+SQNSCFG="), mux, GF(",3,300,90,600,50"));
+    waitResponse(5000L);
+    // <listenAutoRsp1> = 0 - incoming connections wait for SQNSA
+    sendAT(GF("+SQNSCFGEXT="), mux, GF(",1,0,0,0,0"));
+    waitResponse(5000L);
+
+    //AT+SQNSL=<connId>,<txProt>,<lPort>
+    // <txProt> = 0 - TCP
+    sendAT(GF("+SQNSL="), mux, GF(",0,"), port);
+    return waitResponse(5000L) == 1;
+  }
+
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into sends of at most TINY_GSM_SEND_MAX bytes
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
     if (sockets[mux % TINY_GSM_MUX_COUNT]->sock_connected == false) {
       DBG("### Sock closed, cannot send data!");
       return 0;
     }
 
-    sendAT(GF("+SQNSSENDEXT="), mux, ',', (uint16_t)len);
-    waitResponse(10000L, GF(GSM_NL "> "));
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse() != 1) {
-      DBG("### no OK after send");
-      return 0;
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+SQNSSENDEXT="), mux, ',', (uint16_t)chunk);
+      waitResponse(10000L, GF(GSM_NL "> "));
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse() != 1) {
+        DBG("### no OK after send");
+        break;
+      }
+      sent += chunk;
     }
-    return len;
+    return sent;
 
     // uint8_t nAttempts = 5;
     // bool gotPrompt = false;
@@ -727,8 +837,19 @@ TINY_GSM_MODEM_STREAM_UTILITIES()
           index = 5;
           goto finish;
         } else if (data.endsWith(GF(GSM_NL "+SQNSRING:"))) {
-          int mux = stream.readStringUntil(',').toInt();
-          int len = stream.readStringUntil('\n').toInt();
+          String ring = stream.readStringUntil('\n');
+          int mux = ring.toInt();
+          int coma = ring.indexOf(',');
+          if (coma < 0) {
+            // No length: an incoming connection on a listening socket
+            if (server_session && server_session->mux == mux) {
+              server_session->pending = true;
+            }
+            data = "";
+            DBG("### URC Incoming on", mux);
+            continue;
+          }
+          int len = ring.substring(coma + 1).toInt();
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux % TINY_GSM_MUX_COUNT]) {
             sockets[mux % TINY_GSM_MUX_COUNT]->got_data = true;
             sockets[mux % TINY_GSM_MUX_COUNT]->sock_available = len;
@@ -777,6 +898,7 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  GsmServer*    server_session;
 };
 
 #endif
@@ -17,7 +17,11 @@
 
 #define TINY_GSM_MUX_COUNT 5
 
+// Largest single binary USOWR
+#define TINY_GSM_SEND_MAX 1024
+
 #include <TinyGsmCommon.h>
+#include <TinyGsmUdp.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -74,6 +78,7 @@ public:
     this->mux = mux;
     sock_available = 0;
     sock_connected = false;
+    sock_connecting = false;
     got_data = false;
     return true;
   }
@@ -100,10 +105,29 @@ public:
     return connect(host.c_str(), port);
   }
 
+  // Starts connecting and returns as soon as the modem accepts the request.
+  // Completion arrives as a "+UUSOCO: <mux>,<err>" URC, so several
+  // sockets can be opened in parallel; poll connecting() until it clears.
+  virtual int connectAsync(const char *host, uint16_t port) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_connecting = at->modemConnectAsync(host, port, &mux, this);
+    return sock_connecting;
+  }
+
+  bool connecting() {
+    if (sock_connecting) {
+      at->maintain();
+    }
+    return sock_connecting;
+  }
+
   virtual void stop() {
     TINY_GSM_YIELD();
     at->sendAT(GF("+USOCL="), mux);
     sock_connected = false;
+    sock_connecting = false;
     at->waitResponse();
     rx.clear();
   }
@@ -123,6 +147,8 @@ public:
     return write((const uint8_t *)str, strlen(str));
   }
 
+TINY_GSM_CLIENT_WRITEV()
+
   virtual int available() {
     TINY_GSM_YIELD();
     if (!rx.size() && sock_connected) {
@@ -184,6 +210,7 @@ private:
   uint8_t       mux;
   uint16_t      sock_available;
   bool          sock_connected;
+  bool          sock_connecting;
   bool          got_data;
   RxFifo        rx;
 };
@@ -213,8 +240,127 @@ public:
     at->sockets[mux] = this;
     return sock_connected;
   }
+
+  virtual int connectAsync(const char *host, uint16_t port) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_connecting = at->modemConnectAsync(host, port, &mux, this, true);
+    return sock_connecting;
+  }
 };
 
+//============================================================================//
+//============================================================================//
+//                          The UBLOX Server Class
+//============================================================================//
+//============================================================================//
+
+/*
+ * TCP server on a USOLI listening socket. Every incoming connection gets
+ * a new socket, reported by +UUSOLI; accept() binds the next one to a
+ * GsmClient, which is then used like a connected one.
+ */
+class GsmServer
+{
+  friend class TinyGsmUBLOX;
+
+public:
+  GsmServer() {}
+
+  GsmServer(TinyGsmUBLOX& modem) {
+    init(&modem);
+  }
+
+  virtual ~GsmServer() {}
+
+  bool init(TinyGsmUBLOX* modem) {
+    this->at = modem;
+    this->mux = 0;
+    pending = 0;
+    listening = false;
+    return true;
+  }
+
+  bool begin(uint16_t port) {
+    stop();
+    at->sendAT(GF("+USOCR=6"));
+    if (at->waitResponse(GF(GSM_NL "+USOCR:")) != 1) {
+      return false;
+    }
+    mux = at->stream.readStringUntil('\n').toInt();
+    at->waitResponse();
+    at->server_session = this;
+    at->sendAT(GF("+USOLI="), mux, ',', port);
+    listening = (at->waitResponse() == 1);
+    return listening;
+  }
+
+  // Binds the oldest waiting connection to client.
+  // Returns false if nobody has connected meanwhile.
+  bool accept(GsmClient& client) {
+    at->maintain();
+    for (uint8_t sock = 0; sock < TINY_GSM_MUX_COUNT; sock++) {
+      if (pending & (1 << sock)) {
+        pending &= ~(1 << sock);
+        client.init(at, sock);
+        client.sock_connected = true;
+        // Data may have been announced before the client existed
+        client.got_data = true;
+        at->sockets[sock] = &client;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Stops listening, accepted connections stay open
+  void stop() {
+    if (listening) {
+      at->sendAT(GF("+USOCL="), mux);
+      at->waitResponse();
+    }
+    listening = false;
+    pending = 0;
+    if (at->server_session == this) {
+      at->server_session = NULL;
+    }
+  }
+
+  operator bool() {
+    return listening;
+  }
+
+private:
+  TinyGsmUBLOX* at;
+  uint8_t       mux;
+  uint16_t      pending;
+  bool          listening;
+};
+
+//============================================================================//
+//============================================================================//
+//                          The UBLOX UDP Class
+//============================================================================//
+//============================================================================//
+
+/*
+ * UDP on a USOCR=17 socket, see TinyGsmUdpSocket
+ */
+class GsmUdp : public TinyGsmUdpSocket<TinyGsmUBLOX>
+{
+  friend class TinyGsmUBLOX;
+
+public:
+  GsmUdp() {}
+
+  GsmUdp(TinyGsmUBLOX& modem) {
+    init(&modem);
+  }
+};
+
+friend class TinyGsmUdpSocket<TinyGsmUBLOX>;
+
 //============================================================================//
 //============================================================================//
 //                          The UBLOX Modem Functions
@@ -231,6 +377,8 @@ public:
     : stream(stream)
   {
     memset(sockets, 0, sizeof(sockets));
+    memset(udps, 0, sizeof(udps));
+    server_session = NULL;
   }
 
   /*
@@ -619,21 +767,62 @@ protected:
     return (1 == rsp);
   }
 
-  int modemSend(const void* buff, size_t len, uint8_t mux) {
-    sendAT(GF("+USOWR="), mux, ',', len);
-    if (waitResponse(GF("@")) != 1) {
-      return 0;
+  // Uses the asynchronous mode of USOCO, the outcome is reported
+  // later by the "+UUSOCO:" URC
+  bool modemConnectAsync(const char* host, uint16_t port, uint8_t* mux,
+                         GsmClient* client, bool ssl = false) {
+    sendAT(GF("+USOCR=6"));
+    if (waitResponse(GF(GSM_NL "+USOCR:")) != 1) {
+      return false;
     }
-    // 50ms delay, see AT manual section 25.10.4
-    delay(50);
-    stream.write((uint8_t*)buff, len);
-    stream.flush();
-    if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) {
-      return 0;
+    *mux = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    // The URC may arrive before we return, so register the socket first
+    sockets[*mux] = client;
+
+    if (ssl) {
+      sendAT(GF("+USOSEC="), *mux, ",1");
+      waitResponse();
     }
-    streamSkipUntil(','); // Skip mux
-    int sent = stream.readStringUntil('\n').toInt();
+
+    // Enable NODELAY
+    sendAT(GF("+USOSO="), *mux, GF(",6,1,1"));
     waitResponse();
+
+    sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port, GF(",1"));
+    return waitResponse() == 1;
+  }
+
+  size_t modemSend(const void* buff, size_t len, uint8_t mux) {
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  // Splits the data into binary writes of at most TINY_GSM_SEND_MAX bytes
+  size_t modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    size_t sent = 0;
+    while (sent < total) {
+      size_t chunk = TinyGsmMin(total - sent, (size_t)TINY_GSM_SEND_MAX);
+      sendAT(GF("+USOWR="), mux, ',', (uint16_t)chunk);
+      if (waitResponse(GF("@")) != 1) {
+        break;
+      }
+      // 50ms delay, see AT manual section 25.10.4
+      delay(50);
+      TinyGsmWriteSegments(stream, segs, count, sent, chunk);
+      stream.flush();
+      if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) {
+        break;
+      }
+      streamSkipUntil(','); // Skip mux
+      size_t written = stream.readStringUntil('\n').toInt();
+      waitResponse();  // sends back OK after the confirmation of number sent
+      sent += written;
+      if (written != chunk) {
+        break;
+      }
+    }
     return sent;
   }
 
@@ -656,6 +845,79 @@ protected:
     return len;
   }
 
+  bool modemOpenUdp(uint16_t localPort, uint8_t* mux, GsmUdp* udp) {
+    if (localPort) {
+      sendAT(GF("+USOCR=17,"), localPort);
+    } else {
+      sendAT(GF("+USOCR=17"));
+    }
+    if (waitResponse(GF(GSM_NL "+USOCR:")) != 1) {
+      return false;
+    }
+    *mux = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    if (*mux >= TINY_GSM_MUX_COUNT) {
+      return false;
+    }
+    // A TCP client may still point at this id from an earlier connection
+    sockets[*mux] = NULL;
+    udps[*mux] = udp;
+    return true;
+  }
+
+  size_t modemSendTo(const char* host, uint16_t port, const void* buff,
+                     size_t len, uint8_t mux) {
+    // USOST only takes an IP address
+    String ip = host;
+    IPAddress tmp;
+    if (!TinyGsmUdp::parseIp(ip, tmp)) {
+      sendAT(GF("+UDNSRN=0,\""), host, GF("\""));
+      if (waitResponse(70000L, GF(GSM_NL "+UDNSRN:")) != 1) {
+        return 0;
+      }
+      streamSkipUntil('\"');
+      ip = stream.readStringUntil('\"');
+      waitResponse();
+    }
+    sendAT(GF("+USOST="), mux, GF(",\""), ip, GF("\","), port, ',', (uint16_t)len);
+    if (waitResponse(GF("@")) != 1) {
+      return 0;
+    }
+    // 50ms delay, see AT manual section 25.10.4
+    delay(50);
+    stream.write((uint8_t*)buff, len);
+    stream.flush();
+    if (waitResponse(GF(GSM_NL "+USOST:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(','); // Skip mux
+    size_t sent = stream.readStringUntil('\n').toInt();
+    waitResponse();
+    return sent;
+  }
+
+  // +USORF: <mux>,"<ip>",<port>,<len>,"<data>"
+  // A datagram longer than size is cut off by the modem
+  size_t modemReadFrom(uint8_t* buf, size_t size, uint8_t mux,
+                       String& ip, uint16_t& port) {
+    sendAT(GF("+USORF="), mux, ',', size);
+    if (waitResponse(GF(GSM_NL "+USORF:")) != 1) {
+      return 0;
+    }
+    streamSkipUntil(','); // Skip mux
+    streamSkipUntil('\"');
+    ip = stream.readStringUntil('\"');
+    streamSkipUntil(',');
+    port = stream.readStringUntil(',').toInt();
+    size_t len = stream.readStringUntil(',').toInt();
+    streamSkipUntil('\"');
+    len = stream.readBytes(buf, TinyGsmMin(len, size));
+    streamSkipUntil('\"');
+    waitResponse();
+    DBG("### READ:", len, "from", mux);
+    return len;
+  }
+
   size_t modemGetAvailable(uint8_t mux) {
     sendAT(GF("+USORD="), mux, ",0");
     size_t result = 0;
@@ -761,6 +1023,23 @@ public:
           }
           data = "";
           DBG("### Got Data:", mux);
+        } else if (data.endsWith(GF(GSM_NL "+UUSOLI:"))) {
+          // +UUSOLI: <socket>,"<ip>",<port>,<listening socket>,"<local ip>",<local port>
+          int mux = stream.readStringUntil(',').toInt();
+          streamSkipUntil('\n');
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && server_session) {
+            server_session->pending |= (1 << mux);
+          }
+          data = "";
+          DBG("### Incoming:", mux);
+        } else if (data.endsWith(GF(GSM_NL "+UUSORF:"))) {
+          int mux = stream.readStringUntil(',').toInt();
+          int len = stream.readStringUntil('\n').toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && udps[mux]) {
+            udps[mux]->sock_available = len;
+          }
+          data = "";
+          DBG("### Got Datagram:", len, "on", mux);
         } else if (data.endsWith(GF(GSM_NL "+UUSOCL:"))) {
           int mux = stream.readStringUntil('\n').toInt();
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
@@ -768,6 +1047,15 @@ public:
           }
           data = "";
           DBG("### Closed:", mux);
+        } else if (data.endsWith(GF(GSM_NL "+UUSOCO:"))) {
+          int mux = stream.readStringUntil(',').toInt();
+          int err = stream.readStringUntil('\n').toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+            sockets[mux]->sock_connected = (err == 0);
+            sockets[mux]->sock_connecting = false;
+          }
+          data = "";
+          DBG("### Connect:", err, "on", mux);
         }
       }
     } while (millis() - startMillis < timeout);
@@ -802,6 +1090,8 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  GsmUdp*       udps[TINY_GSM_MUX_COUNT];
+  GsmServer*    server_session;
 };
 
 #endif
@@ -141,6 +141,11 @@ public:
     return write((const uint8_t *)str, strlen(str));
   }
 
+  virtual size_t writev(const TinyGsmSegment* segs, size_t count) {
+    TINY_GSM_YIELD();
+    return at->modemSendv(segs, count, mux);
+  }
+
   virtual int available() {
     TINY_GSM_YIELD();
     return at->stream.available();
@@ -717,9 +722,15 @@ protected:
   }
 
   int modemSend(const void* buff, size_t len, uint8_t mux = 0) {
-    stream.write((uint8_t*)buff, len);
+    TinyGsmSegment seg = TinyGsmSeg(buff, len);
+    return modemSendv(&seg, 1, mux);
+  }
+
+  int modemSendv(const TinyGsmSegment* segs, size_t count, uint8_t mux = 0) {
+    size_t total = TinyGsmSegmentsLength(segs, count);
+    TinyGsmWriteSegments(stream, segs, count);
     stream.flush();
-    return len;
+    return total;
   }
 
   bool modemGetConnected(uint8_t mux = 0) {
@@ -0,0 +1,637 @@
+/**
+ * @file       TinyGsmCoap.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmCoap_h
+#define TinyGsmCoap_h
+
+#include <TinyGsmCommon.h>
+#include <TinyGsmUdp.h>
+
+// Room for the header, token and options next to a block of payload
+#define TINY_GSM_COAP_OVERHEAD 32
+
+// Preferred block size for block-wise transfers, 2^(SZX+4) bytes (0..6).
+// By default the largest one that fits into TINY_GSM_UDP_BUFFER.
+#if !defined(TINY_GSM_COAP_BLOCK_SZX)
+  #if TINY_GSM_UDP_BUFFER >= 1024 + TINY_GSM_COAP_OVERHEAD
+    #define TINY_GSM_COAP_BLOCK_SZX 6
+  #elif TINY_GSM_UDP_BUFFER >= 512 + TINY_GSM_COAP_OVERHEAD
+    #define TINY_GSM_COAP_BLOCK_SZX 5
+  #elif TINY_GSM_UDP_BUFFER >= 256 + TINY_GSM_COAP_OVERHEAD
+    #define TINY_GSM_COAP_BLOCK_SZX 4
+  #elif TINY_GSM_UDP_BUFFER >= 128 + TINY_GSM_COAP_OVERHEAD
+    #define TINY_GSM_COAP_BLOCK_SZX 3
+  #elif TINY_GSM_UDP_BUFFER >= 64 + TINY_GSM_COAP_OVERHEAD
+    #define TINY_GSM_COAP_BLOCK_SZX 2
+  #elif TINY_GSM_UDP_BUFFER >= 32 + TINY_GSM_COAP_OVERHEAD
+    #define TINY_GSM_COAP_BLOCK_SZX 1
+  #else
+    #define TINY_GSM_COAP_BLOCK_SZX 0
+  #endif
+#endif
+
+#if (16 << TINY_GSM_COAP_BLOCK_SZX) + TINY_GSM_COAP_OVERHEAD > TINY_GSM_UDP_BUFFER
+  #error "TINY_GSM_COAP_BLOCK_SZX blocks don't fit into TINY_GSM_UDP_BUFFER"
+#endif
+
+// Outgoing message buffer: header, token, options and one block of payload
+#if !defined(TINY_GSM_COAP_BUFFER)
+  #define TINY_GSM_COAP_BUFFER ((16 << TINY_GSM_COAP_BLOCK_SZX) + 48)
+#endif
+
+// Recent exchanges remembered to match and deduplicate responses
+#if !defined(TINY_GSM_COAP_EXCHANGES)
+  #define TINY_GSM_COAP_EXCHANGES 4
+#endif
+
+#define TINY_GSM_COAP_TOKEN_LEN   4
+
+enum TinyGsmCoapMethod {
+  COAP_GET    = 1,
+  COAP_POST   = 2,
+  COAP_PUT    = 3,
+  COAP_DELETE = 4,
+};
+
+enum TinyGsmCoapError {
+  COAP_SEND_FAILED      = -1,
+  COAP_TIMED_OUT        = -2,
+  COAP_RESET            = -3,
+  COAP_INVALID_RESPONSE = -4,
+  COAP_ABORTED          = -5,
+};
+
+// Content-Format values
+#define COAP_TEXT_PLAIN     0
+#define COAP_LINK_FORMAT    40
+#define COAP_OCTET_STREAM   42
+#define COAP_JSON           50
+#define COAP_CBOR           60
+
+// Receives the response payload block by block, return false to abort
+typedef bool (*TinyGsmCoapSink)(uint32_t offset, const uint8_t* data, size_t len, void* arg);
+
+/*
+ * CoAP client (RFC 7252) with block-wise transfers (RFC 7959), on top of
+ * any Arduino UDP, usually a TinyGsm GsmUdp.
+ *
+ *   TinyGsmClientUdp udp(modem);
+ *   TinyGsmCoapClient coap(udp, "coap.example.com");
+ *   int code = coap.post("/r/unit1", payload, len, COAP_CBOR);   // 201
+ *   code = coap.get("/fw/app.bin", sink);                        // 205
+ *
+ * Requests are confirmable by default and retransmitted with exponential
+ * back-off. Responses are returned as class * 100 + detail (205 for 2.05)
+ * or a negative TinyGsmCoapError. Payloads larger than one block are sent
+ * with Block1 and received with Block2, so a download of any size only
+ * needs one block of RAM; it is read from the UDP object and passed to the
+ * sink through the send buffer, which is idle at that point. The UDP
+ * receive buffer (TINY_GSM_UDP_BUFFER for GsmUdp) must hold a whole
+ * message, so the block size is derived from it unless set explicitly.
+ */
+class TinyGsmCoapClient
+{
+public:
+  TinyGsmCoapClient(UDP& udp, const char* host, uint16_t port = 5683)
+    : udp(udp), host(host), port(port)
+  {
+    timeout_ms = 30000L;
+    ack_timeout_ms = 2000;
+    max_retransmit = 4;
+    rnd = millis() ^ 0x5A5A5A5AL;
+    if (!rnd) rnd = 1;
+    next_mid = random16();
+    last = 0;
+    memset(exchanges, 0, sizeof(exchanges));
+    tx_len = 0;
+    tx_ok = false;
+    resetRx();
+  }
+
+  // How long to wait for a separate (delayed) response
+  void setTimeout(uint32_t ms) {
+    timeout_ms = ms;
+  }
+
+  // Initial retransmission timeout and the number of retransmissions
+  void setRetransmission(uint16_t ack_timeout, uint8_t retries) {
+    ack_timeout_ms = ack_timeout;
+    max_retransmit = retries;
+  }
+
+  int get(const char* path, TinyGsmCoapSink sink = NULL, void* arg = NULL,
+          bool confirmable = true) {
+    return request(COAP_GET, path, NULL, 0, -1, sink, arg, confirmable);
+  }
+
+  int post(const char* path, const void* payload, size_t len, int format = COAP_TEXT_PLAIN,
+           TinyGsmCoapSink sink = NULL, void* arg = NULL, bool confirmable = true) {
+    return request(COAP_POST, path, payload, len, format, sink, arg, confirmable);
+  }
+
+  int put(const char* path, const void* payload, size_t len, int format = COAP_TEXT_PLAIN,
+          TinyGsmCoapSink sink = NULL, void* arg = NULL, bool confirmable = true) {
+    return request(COAP_PUT, path, payload, len, format, sink, arg, confirmable);
+  }
+
+  int del(const char* path, bool confirmable = true) {
+    return request(COAP_DELETE, path, NULL, 0, -1, NULL, NULL, confirmable);
+  }
+
+  // Sends one request and streams the response payload to sink.
+  // path may carry a query: "/sensors/temp?unit=C".
+  // format is the Content-Format of the payload, -1 to leave it out.
+  int request(uint8_t method, const char* path,
+              const void* payload, size_t len, int format,
+              TinyGsmCoapSink sink, void* arg, bool confirmable = true)
+  {
+    uint8_t ex = newExchange();
+    const uint8_t* data = (const uint8_t*)payload;
+    uint8_t szx = TINY_GSM_COAP_BLOCK_SZX;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    bool more_out = false;
+    int code;
+
+    // Block1: the payload, one block per exchange
+    do {
+      size_t block = (size_t)16 << szx;
+      size_t chunk = TinyGsmMin(len - sent, block);
+      more_out = (sent + chunk < len);
+      uint32_t block1 = NO_BLOCK;
+      if (len > block || sent) {
+        block1 = ((sent >> (szx + 4)) << 4) | (more_out ? 0x08 : 0) | szx;
+      }
+      // Ask for our block size right away, the server might pick a larger one
+      uint32_t block2 = (method == COAP_GET) ? szx : NO_BLOCK;
+      code = exchange(ex, confirmable, method, path, format, block1, block2,
+                      data + sent, chunk);
+      if (code < 0) {
+        return code;
+      }
+      if (more_out) {
+        if (code != 231) { // 2.31 Continue
+          udp.flush();
+          return code;
+        }
+        // The server may ask for smaller blocks
+        if (rx_block1 != NO_BLOCK && (rx_block1 & 0x07) < szx) {
+          szx = rx_block1 & 0x07;
+        }
+      }
+      sent += chunk;
+    } while (more_out);
+
+    // Block2: the response, streamed to the sink
+    for (;;) {
+      if (code / 100 != 2) {
+        udp.flush();
+        return code;
+      }
+      int res = deliver(received, sink, arg);
+      if (res < 0) {
+        udp.flush();
+        return res;
+      }
+      received += res;
+      if (rx_block2 == NO_BLOCK || !(rx_block2 & 0x08)) {
+        return code;
+      }
+      // Every block but the last one is full, a short one was cut off
+      uint8_t rx_szx = rx_block2 & 0x07;
+      if (rx_szx > 6 || res != (16 << rx_szx)) {
+        return COAP_INVALID_RESPONSE;
+      }
+      // Ask for the block after the one received, in our block size
+      uint32_t next = ((rx_block2 >> 4) + 1) << (rx_szx + 4);
+      szx = TinyGsmMin(rx_szx, szx);
+      uint32_t block2 = ((next >> (szx + 4)) << 4) | szx;
+      code = exchange(ex, confirmable, method, path, -1, NO_BLOCK, block2, NULL, 0);
+      if (code < 0) {
+        return code;
+      }
+    }
+  }
+
+  // Fire and forget: a non-confirmable request, the response is dropped.
+  // Good for periodic reports where a lost one doesn't matter.
+  bool send(uint8_t method, const char* path,
+            const void* payload, size_t len, int format = COAP_TEXT_PLAIN)
+  {
+    uint8_t ex = newExchange();
+    if (!build(TYPE_NON, method, ex, path, format, NO_BLOCK, NO_BLOCK,
+               (const uint8_t*)payload, len)) {
+      return false;
+    }
+    return transmit();
+  }
+
+  // Answers whatever arrived in the meantime: confirmable responses to
+  // send() are acknowledged, anything unknown is reset
+  void loop() {
+    while (receive()) {
+      handleStray();
+    }
+  }
+
+  static int codeOf(uint8_t code) {
+    return (code >> 5) * 100 + (code & 0x1F);
+  }
+
+protected:
+  enum {
+    TYPE_CON = 0,
+    TYPE_NON = 1,
+    TYPE_ACK = 2,
+    TYPE_RST = 3,
+  };
+
+  enum {
+    OPT_URI_PATH        = 11,
+    OPT_CONTENT_FORMAT  = 12,
+    OPT_URI_QUERY       = 15,
+    OPT_BLOCK2          = 23,
+    OPT_BLOCK1          = 27,
+  };
+
+  static const uint32_t NO_BLOCK = 0xFFFFFFFF;
+
+  struct Exchange {
+    uint16_t  mid;
+    uint8_t   token[TINY_GSM_COAP_TOKEN_LEN];
+    bool      used;
+  };
+
+  /*
+   * Exchange table
+   */
+
+  uint16_t random16() {
+    // xorshift32
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return (uint16_t)rnd;
+  }
+
+  // Takes over the oldest slot and gives it a fresh token.
+  // The token stays the same for all blocks of a request.
+  uint8_t newExchange() {
+    last = (last + 1) % TINY_GSM_COAP_EXCHANGES;
+    Exchange& e = exchanges[last];
+    for (uint8_t i = 0; i < TINY_GSM_COAP_TOKEN_LEN; i += 2) {
+      uint16_t r = random16();
+      e.token[i] = r;
+      e.token[i + 1] = r >> 8;
+    }
+    e.mid = 0;
+    e.used = true;
+    return last;
+  }
+
+  int8_t findByToken() {
+    if (rx_tkl != TINY_GSM_COAP_TOKEN_LEN) {
+      return -1;
+    }
+    for (uint8_t i = 0; i < TINY_GSM_COAP_EXCHANGES; i++) {
+      if (exchanges[i].used && !memcmp(exchanges[i].token, rx_token, rx_tkl)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /*
+   * Sending
+   */
+
+  int exchange(uint8_t ex, bool confirmable, uint8_t method, const char* path,
+               int format, uint32_t block1, uint32_t block2,
+               const uint8_t* payload, size_t len)
+  {
+    if (!build(confirmable ? TYPE_CON : TYPE_NON, method, ex, path, format,
+               block1, block2, payload, len)) {
+      return COAP_SEND_FAILED;
+    }
+    if (!transmit()) {
+      return COAP_SEND_FAILED;
+    }
+    return waitResponse(ex, confirmable);
+  }
+
+  bool build(uint8_t type, uint8_t code, uint8_t ex, const char* path, int format,
+             uint32_t block1, uint32_t block2, const uint8_t* payload, size_t len)
+  {
+    Exchange& e = exchanges[ex];
+    e.mid = next_mid++;
+
+    tx_len = 0;
+    tx_ok = true;
+    txByte(0x40 | (type << 4) | TINY_GSM_COAP_TOKEN_LEN);
+    txByte(code);
+    txByte(e.mid >> 8);
+    txByte(e.mid);
+    txBytes(e.token, TINY_GSM_COAP_TOKEN_LEN);
+
+    // Options must go in ascending order
+    uint16_t opt = 0;
+    const char* query = strchr(path, '?');
+    const char* end = query ? query : path + strlen(path);
+    for (const char* p = path; p < end; ) {
+      while (p < end && *p == '/') p++;
+      const char* seg = p;
+      while (p < end && *p != '/') p++;
+      if (p > seg) {
+        txOption(opt, OPT_URI_PATH, (const uint8_t*)seg, p - seg);
+      }
+    }
+    if (format >= 0) {
+      txOptionUint(opt, OPT_CONTENT_FORMAT, format);
+    }
+    while (query) {
+      const char* q = query + 1;
+      query = strchr(q, '&');
+      size_t qlen = query ? (size_t)(query - q) : strlen(q);
+      if (qlen) {
+        txOption(opt, OPT_URI_QUERY, (const uint8_t*)q, qlen);
+      }
+    }
+    if (block2 != NO_BLOCK) {
+      txOptionUint(opt, OPT_BLOCK2, block2);
+    }
+    if (block1 != NO_BLOCK) {
+      txOptionUint(opt, OPT_BLOCK1, block1);
+    }
+    if (payload && len) {
+      txByte(0xFF);
+      txBytes(payload, len);
+    }
+    return tx_ok;
+  }
+
+  void txByte(uint8_t b) {
+    if (tx_len < sizeof(tx_buf)) {
+      tx_buf[tx_len++] = b;
+    } else {
+      tx_ok = false;
+    }
+  }
+
+  void txBytes(const uint8_t* data, size_t len) {
+    while (len--) {
+      txByte(*data++);
+    }
+  }
+
+  // Delta and length nibbles: 0..12 inline, 13/14 with 1/2 extra bytes
+  static uint8_t nibble(uint16_t v) {
+    return v < 13 ? v : (v < 269 ? 13 : 14);
+  }
+
+  void txExtended(uint16_t v) {
+    if (v >= 269) {
+      txByte((v - 269) >> 8);
+      txByte(v - 269);
+    } else if (v >= 13) {
+      txByte(v - 13);
+    }
+  }
+
+  void txOption(uint16_t& last_opt, uint16_t num, const uint8_t* val, size_t len) {
+    uint16_t delta = num - last_opt;
+    last_opt = num;
+    txByte((nibble(delta) << 4) | nibble(len));
+    txExtended(delta);
+    txExtended(len);
+    txBytes(val, len);
+  }
+
+  // Unsigned integer options use as few bytes as possible, 0 has none
+  void txOptionUint(uint16_t& last_opt, uint16_t num, uint32_t val) {
+    uint8_t buf[4];
+    size_t len = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      if (len || (val >> shift) & 0xFF) {
+        buf[len++] = val >> shift;
+      }
+    }
+    txOption(last_opt, num, buf, len);
+  }
+
+  bool transmit() {
+    return udp.beginPacket(host, port) &&
+           udp.write(tx_buf, tx_len) == tx_len &&
+           udp.endPacket();
+  }
+
+  // Empty ACK or RST for a received message
+  void sendEmpty(uint8_t type, uint16_t mid) {
+    uint8_t msg[4] = { (uint8_t)(0x40 | (type << 4)), 0, (uint8_t)(mid >> 8), (uint8_t)mid };
+    if (udp.beginPacket(host, port)) {
+      udp.write(msg, sizeof(msg));
+      udp.endPacket();
+    }
+  }
+
+  /*
+   * Receiving
+   */
+
+  // Retransmits tx_buf until it is acknowledged, then waits for the
+  // response (piggybacked on the ACK or separate)
+  int waitResponse(uint8_t ex, bool confirmable) {
+    Exchange& e = exchanges[ex];
+    uint32_t timeout = ack_timeout_ms + random16() % (ack_timeout_ms / 2 + 1);
+    uint32_t start = millis();
+    uint8_t retries = 0;
+    bool acked = !confirmable;
+    if (acked) {
+      timeout = timeout_ms;
+    }
+    for (;;) {
+      if (!receive()) {
+        if (millis() - start < timeout) {
+          TINY_GSM_YIELD();
+          continue;
+        }
+        if (acked || retries >= max_retransmit) {
+          return COAP_TIMED_OUT;
+        }
+        DBG("### CoAP retransmit:", e.mid);
+        if (!transmit()) {
+          return COAP_SEND_FAILED;
+        }
+        retries++;
+        timeout *= 2;
+        start = millis();
+        continue;
+      }
+      if (rx_type == TYPE_ACK || rx_type == TYPE_RST) {
+        if (rx_mid != e.mid) {
+          udp.flush();    // Late ACK from an earlier exchange
+          continue;
+        }
+        if (rx_type == TYPE_RST) {
+          return COAP_RESET;
+        }
+        if (rx_code == 0) {
+          // Empty ACK, the response follows separately
+          acked = true;
+          timeout = timeout_ms;
+          start = millis();
+          continue;
+        }
+        if (findByToken() == ex) {
+          return codeOf(rx_code);
+        }
+        return COAP_INVALID_RESPONSE;
+      }
+      if (rx_code >= 0x40 && findByToken() == ex) {
+        if (rx_type == TYPE_CON) {
+          sendEmpty(TYPE_ACK, rx_mid);
+        }
+        return codeOf(rx_code);
+      }
+      handleStray();
+    }
+  }
+
+  // A response that doesn't belong to the current exchange
+  void handleStray() {
+    if (rx_type == TYPE_CON) {
+      // Acknowledge duplicates of responses we know, reset the rest
+      sendEmpty(findByToken() >= 0 ? TYPE_ACK : TYPE_RST, rx_mid);
+    }
+    udp.flush();
+  }
+
+  void resetRx() {
+    rx_type = TYPE_RST;
+    rx_code = 0;
+    rx_mid = 0;
+    rx_tkl = 0;
+    rx_block1 = rx_block2 = NO_BLOCK;
+  }
+
+  // Parses the header and options of the next datagram.
+  // The payload, if any, is left in the UDP buffer.
+  bool receive() {
+    while (udp.parsePacket() > 0) {
+      resetRx();
+      uint8_t hdr[4];
+      if (udp.read(hdr, 4) != 4 || (hdr[0] >> 6) != 1 || (hdr[0] & 0x0F) > 8) {
+        udp.flush();
+        continue;
+      }
+      rx_type = (hdr[0] >> 4) & 0x03;
+      rx_tkl = hdr[0] & 0x0F;
+      rx_code = hdr[1];
+      rx_mid = (hdr[2] << 8) | hdr[3];
+      if (udp.read(rx_token, rx_tkl) != rx_tkl) {
+        udp.flush();
+        continue;
+      }
+      if (!readOptions()) {
+        udp.flush();
+        continue;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // Reads options up to the payload marker, keeps Block1/Block2
+  bool readOptions() {
+    uint16_t num = 0;
+    for (;;) {
+      int b = udp.read();
+      if (b < 0 || b == 0xFF) {
+        return true;
+      }
+      int delta = readExtended(b >> 4);
+      int len = readExtended(b & 0x0F);
+      if (delta < 0 || len < 0) {
+        return false;
+      }
+      num += delta;
+      uint32_t val = 0;
+      for (int i = 0; i < len; i++) {
+        int c = udp.read();
+        if (c < 0) {
+          return false;
+        }
+        val = (val << 8) | c;
+      }
+      if (num == OPT_BLOCK2) {
+        rx_block2 = val;
+      } else if (num == OPT_BLOCK1) {
+        rx_block1 = val;
+      }
+    }
+  }
+
+  int readExtended(uint8_t v) {
+    if (v == 13) {
+      int b = udp.read();
+      return b < 0 ? -1 : b + 13;
+    }
+    if (v == 14) {
+      int b1 = udp.read();
+      int b2 = udp.read();
+      return (b1 < 0 || b2 < 0) ? -1 : ((b1 << 8) | b2) + 269;
+    }
+    return v == 15 ? -1 : v;
+  }
+
+  // Passes the payload of the current response to the sink, through
+  // tx_buf (free at this point). Returns the payload size.
+  int deliver(uint32_t offset, TinyGsmCoapSink sink, void* arg) {
+    if (rx_block2 != NO_BLOCK) {
+      // Where the server says this block starts
+      offset = (rx_block2 >> 4) << ((rx_block2 & 0x07) + 4);
+    }
+    int total = 0;
+    for (;;) {
+      int n = udp.read(tx_buf, sizeof(tx_buf));
+      if (n <= 0) {
+        return total;
+      }
+      if (sink && !sink(offset + total, tx_buf, n, arg)) {
+        return COAP_ABORTED;
+      }
+      total += n;
+    }
+  }
+
+protected:
+  UDP&          udp;
+  const char*   host;
+  uint16_t      port;
+  uint32_t      timeout_ms;
+  uint16_t      ack_timeout_ms;
+  uint8_t       max_retransmit;
+
+  uint32_t      rnd;
+  uint16_t      next_mid;
+  Exchange      exchanges[TINY_GSM_COAP_EXCHANGES];
+  uint8_t       last;
+
+  uint8_t       tx_buf[TINY_GSM_COAP_BUFFER];
+  uint16_t      tx_len;
+  bool          tx_ok;
+
+  uint8_t       rx_type;
+  uint8_t       rx_code;
+  uint16_t      rx_mid;
+  uint8_t       rx_tkl;
+  uint8_t       rx_token[8];
+  uint32_t      rx_block1;
+  uint32_t      rx_block2;
+};
+
+#endif
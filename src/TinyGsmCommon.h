@@ -43,11 +43,15 @@
 
 #if defined(__AVR__)
   #define TINY_GSM_PROGMEM PROGMEM
+  #define TINY_GSM_READ_BYTE(p) pgm_read_byte(p)
+  #define TINY_GSM_READ_WORD(p) pgm_read_word(p)
   typedef const __FlashStringHelper* GsmConstStr;
   #define GFP(x) (reinterpret_cast<GsmConstStr>(x))
   #define GF(x)  F(x)
 #else
   #define TINY_GSM_PROGMEM
+  #define TINY_GSM_READ_BYTE(p) (*(p))
+  #define TINY_GSM_READ_WORD(p) (*(p))
   typedef const char* GsmConstStr;
   #define GFP(x) x
   #define GF(x)  x
@@ -104,6 +108,25 @@ struct Sms {
   String message;                // <data>
 };
 
+// Longest text kept by listSmsMessages(), including the terminating NUL.
+// In bytes: GSM_7bit text is UTF-8, where most non-ASCII characters take two.
+#if !defined(TINY_GSM_SMS_TEXT_LEN)
+  #define TINY_GSM_SMS_TEXT_LEN 161
+#endif
+
+// One message of a listing, in fixed buffers the caller provides
+struct SmsEntry {
+  uint8_t     index;                        // Storage index, for deleteSmsMessage()
+  SmsStatus   status;                       // <stat>
+  SmsAlphabet alphabet;                     // GSM_7bit text is UTF-8, UCS2 is UTF-16BE
+  char        sender[24];                   // <oa>
+  char        timestamp[24];                // <scts>
+  size_t      length;                       // Length of text
+  char        text[TINY_GSM_SMS_TEXT_LEN];  // <data>, cut off if longer
+};
+
+typedef void (*SmsCallback)(const SmsEntry& sms, void* arg);
+
 struct StatPrefferStore {
     String REC_UNREAD = F("REC UNREAD"); //Received unread messages
     String REC_READ   = F("REC READ");   //Received read messages
@@ -172,32 +195,681 @@ IPAddress TinyGsmIpFromString(const String& strIP) {
   return IPAddress(Parts[0], Parts[1], Parts[2], Parts[3]);
 }
 
+/*
+ * One piece of a scatter-gather write. Pieces in flash (GF()/F() strings)
+ * are copied out through a small stack buffer, so a request assembled
+ * from constants and RAM data needs neither a String nor a single send
+ * per piece:
+ *
+ *   TinyGsmSegment req[] = {
+ *     TinyGsmSeg(GF("GET ")), TinyGsmSeg(resource),
+ *     TinyGsmSeg(GF(" HTTP/1.0\r\n\r\n"))
+ *   };
+ *   client.writev(req, 3);
+ */
+struct TinyGsmSegment {
+  const void* data;
+  size_t      len;
+  bool        flash;  // data is in PROGMEM (AVR only)
+};
+
+static inline
+TinyGsmSegment TinyGsmSeg(const void* data, size_t len) {
+  TinyGsmSegment seg = { data, len, false };
+  return seg;
+}
+
+static inline
+TinyGsmSegment TinyGsmSeg(const char* str) {
+  return TinyGsmSeg(str, strlen(str));
+}
+
+static inline
+TinyGsmSegment TinyGsmSeg(const String& str) {
+  return TinyGsmSeg(str.c_str(), str.length());
+}
+
+#if defined(__AVR__)
+static inline
+TinyGsmSegment TinyGsmSeg(GsmConstStr str) {
+  TinyGsmSegment seg = { str, strlen_P((const char*)str), true };
+  return seg;
+}
+#endif
+
+static inline
+size_t TinyGsmSegmentsLength(const TinyGsmSegment* segs, size_t count) {
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    total += segs[i].len;
+  }
+  return total;
+}
+
+static const char TinyGsmHexDigits[] = "0123456789ABCDEF";
+
+/*
+ * Writes bytes as uppercase hex. Digits are built in a stack block, so the
+ * stream gets one write() per 16 bytes instead of print()s per digit.
+ */
+static inline
+void TinyGsmWriteHex(Stream& stream, const uint8_t* data, size_t len, bool flash = false)
+{
+  char buf[32];
+  while (len) {
+    size_t n = TinyGsmMin(len, sizeof(buf) / 2);
+    const uint8_t* src = data;
+#if defined(__AVR__)
+    uint8_t block[sizeof(buf) / 2];
+    if (flash) {
+      memcpy_P(block, data, n);
+      src = block;
+    }
+#else
+    (void)flash;  // Flash is ordinary memory here
+#endif
+    for (size_t i = 0; i < n; i++) {
+      buf[i*2]     = TinyGsmHexDigits[src[i] >> 4];
+      buf[i*2 + 1] = TinyGsmHexDigits[src[i] & 0x0F];
+    }
+    stream.write((const uint8_t*)buf, n * 2);
+    data += n;
+    len -= n;
+  }
+}
+
+// Writes UTF-16 code units as big-endian hex, as UCS2 SMS text takes them
+static inline
+void TinyGsmWriteHex16(Stream& stream, const uint16_t* units, size_t len)
+{
+  char buf[32];
+  while (len) {
+    size_t n = TinyGsmMin(len, sizeof(buf) / 4);
+    for (size_t i = 0; i < n; i++) {
+      uint16_t u = units[i];
+      buf[i*4]     = TinyGsmHexDigits[u >> 12];
+      buf[i*4 + 1] = TinyGsmHexDigits[(u >> 8) & 0x0F];
+      buf[i*4 + 2] = TinyGsmHexDigits[(u >> 4) & 0x0F];
+      buf[i*4 + 3] = TinyGsmHexDigits[u & 0x0F];
+    }
+    stream.write((const uint8_t*)buf, n * 4);
+    units += n;
+    len -= n;
+  }
+}
+
+// Writes len bytes of the concatenated segments, starting skip bytes in,
+// as hex digits if hex is set (TINY_GSM_USE_HEX)
+static inline
+size_t TinyGsmWriteSegments(Stream& stream, const TinyGsmSegment* segs, size_t count,
+                            size_t skip = 0, size_t len = (size_t)-1, bool hex = false)
+{
+  size_t written = 0;
+  for (size_t i = 0; i < count && written < len; i++) {
+    const uint8_t* data = (const uint8_t*)segs[i].data;
+    size_t n = segs[i].len;
+    if (skip >= n) {
+      skip -= n;
+      continue;
+    }
+    data += skip;
+    n = TinyGsmMin(n - skip, len - written);
+    skip = 0;
+    if (hex) {
+      TinyGsmWriteHex(stream, data, n, segs[i].flash);
+      written += n;
+      continue;
+    }
+#if defined(__AVR__)
+    if (segs[i].flash) {
+      uint8_t buf[16];
+      for (size_t done = 0; done < n; ) {
+        size_t chunk = TinyGsmMin(n - done, sizeof(buf));
+        memcpy_P(buf, data + done, chunk);
+        stream.write(buf, chunk);
+        done += chunk;
+      }
+      written += n;
+      continue;
+    }
+#endif
+    stream.write(data, n);
+    written += n;
+  }
+  return written;
+}
+
+/*
+ * GSM 03.38 default alphabet (7-bit), converted to and from UTF-8 with
+ * lookup tables. Characters of the extension table (€ [ ] { } etc.) are
+ * sent as an escape septet and a second one, so they count twice against
+ * the 160 septets of a message.
+ */
+
+#define TINY_GSM_GSM7_ESC 0x1B
+
+// Set in TinyGsmGsm7FromUnicode() results for extension table characters
+#define TINY_GSM_GSM7_EXT 0x80
+
+static inline
+uint16_t TinyGsmGsm7ToUnicode(uint8_t septet, bool extended) {
+  static const uint16_t basic[128] TINY_GSM_PROGMEM = {
+      0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+      0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+      0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+      0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+      0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+      0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+      0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+      0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+      0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+      0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+      0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+      0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+      0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+      0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+      0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+      0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+  };
+  if (extended) {
+    switch (septet) {
+    case 0x0A: return 0x000C;
+    case 0x14: return '^';
+    case 0x28: return '{';
+    case 0x29: return '}';
+    case 0x2F: return '\\';
+    case 0x3C: return '[';
+    case 0x3D: return '~';
+    case 0x3E: return ']';
+    case 0x40: return '|';
+    case 0x65: return 0x20AC;  // Euro sign
+    }
+    // Unknown extensions show as the basic character
+  }
+  return TINY_GSM_READ_WORD(&basic[septet & 0x7F]);
+}
+
+// Septet for a Unicode character, TINY_GSM_GSM7_EXT | septet for the
+// extension table, '?' if there's no equivalent
+static inline
+uint8_t TinyGsmGsm7FromUnicode(uint32_t cp) {
+  static const uint8_t latin1[256] TINY_GSM_PROGMEM = {
+      0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x0A, 0x3F, 0x8A, 0x0D, 0x3F, 0x3F,
+      0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F,
+      0x20, 0x21, 0x22, 0x23, 0x02, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+      0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+      0x00, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+      0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0xBC, 0xAF, 0xBE, 0x94, 0x11,
+      0x3F, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+      0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0xA8, 0xC0, 0xA9, 0xBD, 0x3F,
+      0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F,
+      0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F,
+      0x20, 0x40, 0x3F, 0x01, 0x24, 0x03, 0x3F, 0x5F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F,
+      0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x60,
+      0x3F, 0x3F, 0x3F, 0x3F, 0x5B, 0x0E, 0x1C, 0x09, 0x3F, 0x1F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F,
+      0x3F, 0x5D, 0x3F, 0x3F, 0x3F, 0x3F, 0x5C, 0x3F, 0x0B, 0x3F, 0x3F, 0x3F, 0x5E, 0x3F, 0x3F, 0x1E,
+      0x7F, 0x3F, 0x3F, 0x3F, 0x7B, 0x0F, 0x1D, 0x3F, 0x04, 0x05, 0x3F, 0x3F, 0x07, 0x3F, 0x3F, 0x3F,
+      0x3F, 0x7D, 0x08, 0x3F, 0x3F, 0x3F, 0x7C, 0x3F, 0x0C, 0x06, 0x3F, 0x3F, 0x7E, 0x3F, 0x3F, 0x3F,
+  };
+  if (cp < 0x100) {
+    return TINY_GSM_READ_BYTE(&latin1[cp]);
+  }
+  switch (cp) {
+  case 0x0393: return 0x13;  // Greek capitals
+  case 0x0394: return 0x10;
+  case 0x0398: return 0x19;
+  case 0x039B: return 0x14;
+  case 0x039E: return 0x1A;
+  case 0x03A0: return 0x16;
+  case 0x03A3: return 0x18;
+  case 0x03A6: return 0x12;
+  case 0x03A8: return 0x17;
+  case 0x03A9: return 0x15;
+  case 0x20AC: return TINY_GSM_GSM7_EXT | 0x65;
+  }
+  return '?';
+}
+
+// Next code point of a UTF-8 string, U+FFFD for a malformed sequence
+static inline
+uint32_t TinyGsmUtf8Next(const char*& p, const char* end) {
+  uint8_t c = *p++;
+  if (c < 0x80) {
+    return c;
+  }
+  uint8_t n = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+  if (!n || c >= 0xF8) {
+    return 0xFFFD;
+  }
+  uint32_t cp = c & (0x3F >> n);
+  while (n--) {
+    if (p == end || (*p & 0xC0) != 0x80) {
+      return 0xFFFD;
+    }
+    cp = (cp << 6) | (*p++ & 0x3F);
+  }
+  return cp;
+}
+
+// Writes cp as UTF-8 if it fits into size, returns the bytes written
+static inline
+size_t TinyGsmUtf8Put(char* out, size_t size, uint32_t cp) {
+  size_t n = (cp < 0x80) ? 1 : (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4;
+  if (n > size) {
+    return 0;
+  }
+  if (n == 1) {
+    out[0] = cp;
+    return 1;
+  }
+  for (size_t i = n - 1; i > 0; i--) {
+    out[i] = 0x80 | (cp & 0x3F);
+    cp >>= 6;
+  }
+  out[0] = (0xF00 >> n) | cp;
+  return n;
+}
+
+/*
+ * Bytes of a UTF-8 text that fit into max_septets, whole characters only.
+ * The septets they take are stored to septets, if given.
+ */
+static inline
+size_t TinyGsmGsm7Fit(const char* utf8, size_t len, size_t max_septets,
+                      size_t* septets = NULL) {
+  const char* p = utf8;
+  const char* end = utf8 + len;
+  size_t n = 0;
+  while (p < end) {
+    const char* next = p;
+    uint8_t g = TinyGsmGsm7FromUnicode(TinyGsmUtf8Next(next, end));
+    size_t w = (g & TINY_GSM_GSM7_EXT) ? 2 : 1;
+    if (n + w > max_septets) {
+      break;
+    }
+    n += w;
+    p = next;
+  }
+  if (septets) {
+    *septets = n;
+  }
+  return p - utf8;
+}
+
+// Septets a UTF-8 text takes
+static inline
+size_t TinyGsmGsm7Length(const char* utf8, size_t len) {
+  size_t n;
+  TinyGsmGsm7Fit(utf8, len, (size_t)-1, &n);
+  return n;
+}
+
+/*
+ * Packs a UTF-8 text into ud, starting at septet start (after a user data
+ * header, which is kept). Returns the septet count including start, which
+ * is 0 for an empty text without header, or (size_t)-1 if it doesn't fit
+ * into ud_size octets.
+ */
+static inline
+size_t TinyGsmGsm7Pack(const char* utf8, size_t len, uint8_t* ud, size_t ud_size,
+                       size_t start = 0) {
+  const char* p = utf8;
+  const char* end = utf8 + len;
+  size_t n = start;
+  size_t o = start * 7 / 8;
+  uint8_t bits = start * 7 % 8;
+  uint16_t acc = 0;  // Fill bits after the header are 0
+  while (p < end) {
+    uint8_t g = TinyGsmGsm7FromUnicode(TinyGsmUtf8Next(p, end));
+    uint8_t septets[2] = { TINY_GSM_GSM7_ESC, (uint8_t)(g & 0x7F) };
+    for (uint8_t i = (g & TINY_GSM_GSM7_EXT) ? 0 : 1; i < 2; i++) {
+      acc |= septets[i] << bits;
+      bits += 7;
+      n++;
+      if (bits >= 8) {
+        if (o >= ud_size) {
+          return (size_t)-1;
+        }
+        ud[o++] = acc;
+        acc >>= 8;
+        bits -= 8;
+      }
+    }
+  }
+  if (bits) {
+    if (o >= ud_size) {
+      return (size_t)-1;
+    }
+    ud[o] = acc;
+  }
+  return n;
+}
+
+/*
+ * Unpacks septets into UTF-8, fed with packed octets as they arrive.
+ * Whole 7-octet blocks are unpacked 8 septets at a time. The output is
+ * cut off at a character boundary when it fills up, see overflow.
+ *
+ * septets is the user data length (UDL), skip the septets taken by a user
+ * data header. Octets beyond the last septet are ignored.
+ */
+class TinyGsmGsm7Decoder
+{
+public:
+  TinyGsmGsm7Decoder(char* out, size_t size, size_t septets = (size_t)-1,
+                     size_t skip = 0)
+    : overflow(false), out(out), size(size), pos(0),
+      septets(septets), skip(skip), acc(0), bits(0), escape(false) {}
+
+  void write(const uint8_t* data, size_t len) {
+    while (len) {
+      if (bits == 0 && len >= 7) {
+        septet(data[0] & 0x7F);
+        septet(((data[0] >> 7) | (data[1] << 1)) & 0x7F);
+        septet(((data[1] >> 6) | (data[2] << 2)) & 0x7F);
+        septet(((data[2] >> 5) | (data[3] << 3)) & 0x7F);
+        septet(((data[3] >> 4) | (data[4] << 4)) & 0x7F);
+        septet(((data[4] >> 3) | (data[5] << 5)) & 0x7F);
+        septet(((data[5] >> 2) | (data[6] << 6)) & 0x7F);
+        septet(data[6] >> 1);
+        data += 7;
+        len -= 7;
+        continue;
+      }
+      acc |= *data++ << bits;
+      bits += 8;
+      len--;
+      while (bits >= 7) {
+        septet(acc & 0x7F);
+        acc >>= 7;
+        bits -= 7;
+      }
+    }
+  }
+
+  // Switches to another output buffer and clears overflow, returns the
+  // length of the last one
+  size_t output(char* buf, size_t buf_size) {
+    size_t n = pos;
+    out = buf;
+    size = buf_size;
+    pos = 0;
+    overflow = false;
+    return n;
+  }
+
+  size_t length() const {
+    return pos;
+  }
+
+  bool    overflow;   // Characters were dropped for lack of space
+
+private:
+  void septet(uint8_t s) {
+    if (!septets) {
+      return;
+    }
+    septets--;
+    if (skip) {
+      skip--;
+      return;
+    }
+    if (s == TINY_GSM_GSM7_ESC && !escape) {
+      escape = true;
+      return;
+    }
+    uint16_t cp = TinyGsmGsm7ToUnicode(s, escape);
+    escape = false;
+    size_t n = overflow ? 0 : TinyGsmUtf8Put(out + pos, size - pos, cp);
+    if (!n) {
+      overflow = true;
+    }
+    pos += n;
+  }
+
+  char*   out;
+  size_t  size;
+  size_t  pos;
+  size_t  septets;
+  size_t  skip;
+  uint16_t acc;
+  uint8_t bits;
+  bool    escape;
+};
+
+// Unpacks septets [skip, septets) of packed into UTF-8, returns its length
+static inline
+size_t TinyGsmGsm7Unpack(const uint8_t* packed, size_t septets, size_t skip,
+                         char* out, size_t size) {
+  TinyGsmGsm7Decoder dec(out, size, septets, skip);
+  dec.write(packed, (septets * 7 + 7) / 8);
+  return dec.length();
+}
+
+// Value of a hex digit, 0xFF for anything else
+static inline
+uint8_t TinyGsmHexNibble(char c) {
+  static const uint8_t t[256] TINY_GSM_PROGMEM = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  };
+  return TINY_GSM_READ_BYTE(&t[(uint8_t)c]);
+}
+
+// Four hex digits as a 16-bit value, -1 if any of them isn't one
+static inline
+int32_t TinyGsmHexUnit(const char* hex) {
+  uint8_t n0 = TinyGsmHexNibble(hex[0]);
+  uint8_t n1 = TinyGsmHexNibble(hex[1]);
+  uint8_t n2 = TinyGsmHexNibble(hex[2]);
+  uint8_t n3 = TinyGsmHexNibble(hex[3]);
+  if ((n0 | n1 | n2 | n3) & 0xF0) {
+    return -1;
+  }
+  return ((uint16_t)n0 << 12) | (n1 << 8) | (n2 << 4) | n3;
+}
+
+/*
+ * Decodes pairs of hex digits into out, returns the bytes written. Stops
+ * at the first pair that isn't hex. The loop has no branches on the data,
+ * so compilers can unroll and vectorize it.
+ */
+static inline
+size_t TinyGsmHexDecode(const char* hex, size_t pairs, uint8_t* out) {
+  uint8_t bad = 0;
+  for (size_t i = 0; i < pairs; i++) {
+    uint8_t hi = TinyGsmHexNibble(hex[i*2]);
+    uint8_t lo = TinyGsmHexNibble(hex[i*2 + 1]);
+    bad |= hi | lo;
+    out[i] = (hi << 4) | (lo & 0x0F);
+  }
+  if (!(bad & 0xF0)) {
+    return pairs;
+  }
+  // Rare: find where the bad pair is
+  size_t n = 0;
+  while ((TinyGsmHexNibble(hex[n*2]) | TinyGsmHexNibble(hex[n*2 + 1])) < 0x10) {
+    n++;
+  }
+  return n;
+}
+
+// Packed septets in hex (USSD with DCS 15) to UTF-8, up to the first
+// pair that isn't hex
 static inline
 String TinyGsmDecodeHex7bit(String &instr) {
   String result;
-  byte reminder = 0;
-  int bitstate = 7;
-  for (unsigned i=0; i<instr.length(); i+=2) {
-    char buf[4] = { 0, };
-    buf[0] = instr[i];
-    buf[1] = instr[i+1];
-    byte b = strtol(buf, NULL, 16);
-
-    byte bb = b << (7 - bitstate);
-    char c = (bb + reminder) & 0x7F;
-    result += c;
-    reminder = b >> bitstate;
-    bitstate--;
-    if (bitstate == 0) {
-      char c = reminder;
-      result += c;
-      reminder = 0;
-      bitstate = 7;
+  result.reserve(instr.length() * 4 / 7);
+  // A 7-octet block is 8 characters, 3 bytes each at most
+  char out[25];
+  TinyGsmGsm7Decoder dec(out, sizeof(out) - 1);
+  const char* hex = instr.c_str();
+  size_t octets = instr.length() / 2;
+  for (size_t i = 0; i < octets; ) {
+    uint8_t block[7];
+    size_t want = TinyGsmMin(octets - i, sizeof(block));
+    size_t n = TinyGsmHexDecode(hex + i*2, want, block);
+    dec.write(block, n);
+    out[dec.output(out, sizeof(out) - 1)] = '\0';
+    result += out;
+    i += n;
+    if (n != want) {
+      octets = i;
     }
   }
+  // A CR fills up the last octet when 7 of its bits are unused
+  if (octets % 7 == 0 && result.endsWith("\r")) {
+    result.remove(result.length() - 1);
+  }
   return result;
 }
 
+/*
+ * Reads len bytes sent as hex digits (TINY_GSM_USE_HEX) into a FIFO,
+ * 32 bytes at a time. Gives up after timeout_ms without new data, or on
+ * a character that isn't hex. Returns the bytes stored.
+ */
+template<class T>
+size_t TinyGsmReadHex(Stream& stream, T& fifo, size_t len, uint32_t timeout_ms) {
+  char hex[64];
+  uint8_t bytes[sizeof(hex) / 2];
+  size_t done = 0;
+  while (done < len) {
+    size_t want = TinyGsmMin(len - done, sizeof(bytes)) * 2;
+    size_t got = 0;
+    uint32_t startMillis = millis();
+    while (got < want) {
+      int avail = stream.available();
+      if (avail > 0) {
+        got += stream.readBytes(hex + got, TinyGsmMin((size_t)avail, want - got));
+        startMillis = millis();
+      } else if (millis() - startMillis >= timeout_ms) {
+        break;
+      } else {
+        TINY_GSM_YIELD();
+      }
+    }
+    size_t n = TinyGsmHexDecode(hex, got / 2, bytes);
+    fifo.put(bytes, n);
+    done += n;
+    if (n * 2 != want) {
+      break;
+    }
+  }
+  return done;
+}
+
+/*
+ * Converts UTF-16 code units to UTF-8, pairing surrogates, fed as they
+ * arrive. Unpaired surrogates become U+FFFD. The output is cut off at a
+ * character boundary when it fills up, see overflow.
+ */
+class TinyGsmUtf16Decoder
+{
+public:
+  TinyGsmUtf16Decoder(char* out, size_t size)
+    : overflow(false), out(out), size(size), pos(0), high(0) {}
+
+  void unit(uint16_t u) {
+    if (high) {
+      uint16_t h = high;
+      high = 0;
+      if (u >= 0xDC00 && u < 0xE000) {
+        put(0x10000 + (((uint32_t)(h - 0xD800) << 10) | (u - 0xDC00)));
+        return;
+      }
+      put(0xFFFD);
+    }
+    if (u >= 0xD800 && u < 0xDC00) {
+      high = u;
+    } else if (u >= 0xDC00 && u < 0xE000) {
+      put(0xFFFD);
+    } else {
+      put(u);
+    }
+  }
+
+  // Call after the last unit, for a high surrogate without its pair
+  void flush() {
+    if (high) {
+      high = 0;
+      put(0xFFFD);
+    }
+  }
+
+  // Switches to another output buffer and clears overflow, returns the
+  // length of the last one
+  size_t output(char* buf, size_t buf_size) {
+    size_t n = pos;
+    out = buf;
+    size = buf_size;
+    pos = 0;
+    overflow = false;
+    return n;
+  }
+
+  size_t length() const {
+    return pos;
+  }
+
+  bool    overflow;   // Characters were dropped for lack of space
+
+private:
+  void put(uint32_t cp) {
+    size_t n = overflow ? 0 : TinyGsmUtf8Put(out + pos, size - pos, cp);
+    if (!n) {
+      overflow = true;
+    }
+    pos += n;
+  }
+
+  char*   out;
+  size_t  size;
+  size_t  pos;
+  uint16_t high;
+};
+
+// UTF-16BE octets to UTF-8, returns its length. out is not terminated.
+static inline
+size_t TinyGsmUtf16ToUtf8(const uint8_t* be, size_t len, char* out, size_t size) {
+  TinyGsmUtf16Decoder dec(out, size);
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    dec.unit((be[i] << 8) | be[i + 1]);
+  }
+  dec.flush();
+  return dec.length();
+}
+
+// UTF-16BE in hex (UCS2 SMS and USSD) to UTF-8, returns its length.
+// Stops at the first character that isn't a hex digit. out is not terminated.
+static inline
+size_t TinyGsmHexToUtf8(const char* hex, size_t len, char* out, size_t size) {
+  TinyGsmUtf16Decoder dec(out, size);
+  for (size_t i = 0; i + 3 < len; i += 4) {
+    int32_t u = TinyGsmHexUnit(hex + i);
+    if (u < 0) {
+      break;
+    }
+    dec.unit(u);
+  }
+  dec.flush();
+  return dec.length();
+}
+
 static inline
 String TinyGsmDecodeHex8bit(String &instr) {
   String result;
@@ -211,28 +883,29 @@ String TinyGsmDecodeHex8bit(String &instr) {
   return result;
 }
 
+// UTF-16BE in hex (USSD with DCS 72) to UTF-8
 static inline
 String TinyGsmDecodeHex16bit(String &instr) {
   String result;
-  for (unsigned i=0; i<instr.length(); i+=4) {
-    char buf[4] = { 0, };
-    buf[0] = instr[i];
-    buf[1] = instr[i+1];
-    char b = strtol(buf, NULL, 16);
-    if (b) { // If high byte is non-zero, we can't handle it ;(
-#if defined(TINY_GSM_UNICODE_TO_HEX)
-      result += "\\x";
-      result += instr.substring(i, i+4);
-#else
-      result += "?";
-#endif
-    } else {
-      buf[0] = instr[i+2];
-      buf[1] = instr[i+3];
-      b = strtol(buf, NULL, 16);
-      result += b;
+  result.reserve(instr.length() / 2);
+  // 8 code units, 3 bytes of UTF-8 each at most, plus a surrogate pair
+  // whose high half was held over from the previous block
+  char out[4 + 8 * 3 + 1];
+  TinyGsmUtf16Decoder dec(out, sizeof(out) - 1);
+  for (unsigned i = 0; i + 3 < instr.length(); i += 4) {
+    int32_t u = TinyGsmHexUnit(instr.c_str() + i);
+    if (u < 0) {
+      break;
+    }
+    dec.unit(u);
+    if ((i / 4) % 8 == 7) {
+      out[dec.output(out, sizeof(out) - 1)] = '\0';
+      result += out;
     }
   }
+  dec.flush();
+  out[dec.length()] = '\0';
+  result += out;
   return result;
 }
 
@@ -274,7 +947,35 @@ String TinyGsmDecodeHex16bit(String &instr) {
   virtual size_t write(const char *str) { \
     if (str == NULL) return 0; \
     return write((const uint8_t *)str, strlen(str)); \
+  } \
+  \
+  TINY_GSM_CLIENT_WRITEV()
+
+
+// Sends several segments (RAM or flash) with a single modem send command.
+// On AVR, print(F("...")) also goes out in one send instead of one per
+// character.
+#if defined(__AVR__)
+#define TINY_GSM_CLIENT_WRITEV() \
+  virtual size_t writev(const TinyGsmSegment* segs, size_t count) { \
+    TINY_GSM_YIELD(); \
+    at->maintain(); \
+    return at->modemSendv(segs, count, mux); \
+  } \
+  \
+  using Print::print; \
+  size_t print(GsmConstStr str) { \
+    TinyGsmSegment seg = TinyGsmSeg(str); \
+    return writev(&seg, 1); \
+  }
+#else
+#define TINY_GSM_CLIENT_WRITEV() \
+  virtual size_t writev(const TinyGsmSegment* segs, size_t count) { \
+    TINY_GSM_YIELD(); \
+    at->maintain(); \
+    return at->modemSendv(segs, count, mux); \
   }
+#endif
 
 
 // Returns the combined number of characters available in the TinyGSM fifo
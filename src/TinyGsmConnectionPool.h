@@ -0,0 +1,191 @@
+/**
+ * @file       TinyGsmConnectionPool.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmConnectionPool_h
+#define TinyGsmConnectionPool_h
+
+// Include this after the modem header (or TinyGsmClient.h)
+#if !defined(TINY_GSM_MUX_COUNT)
+  #error "Please include the modem header before TinyGsmConnectionPool.h"
+#endif
+
+// The A6/A7 pick the mux when connecting, the pool needs clients on fixed ones
+#if defined(TinyGsmClientA6_h)
+  #error "TinyGsmConnectionPool does not support the A6/A7"
+#endif
+
+#include <TinyGsmCommon.h>
+
+#ifndef TINY_GSM_POOL_HOST_LEN
+  #define TINY_GSM_POOL_HOST_LEN 48
+#endif
+
+/*
+ * Keeps connected clients on a range of mux slots and hands them out again
+ * for the same host:port, saving the connect round trip and TCP handshake.
+ *
+ * Usage:
+ *   TinyGsmConnectionPool<TinyGsm> pool(modem);
+ *   TinyGsmClient* client = pool.acquire("example.com", 80);
+ *   if (client) {
+ *     ... request/response ...
+ *     pool.release(client);  // keep the socket open for the next acquire()
+ *   }
+ *
+ * The pool owns the mux slots [firstMux, firstMux + N), don't create other
+ * clients on those. Slots past the modem's TINY_GSM_MUX_COUNT are left unused.
+ * Sockets closed by the remote side are noticed through the usual URC
+ * handling (sock_connected) and are simply reconnected.
+ *
+ * Works with every driver whose GsmClient is created on a given mux, that
+ * is all of them except the A6/A7.
+ */
+template <class Modem, uint8_t N = TINY_GSM_MUX_COUNT>
+class TinyGsmConnectionPool
+{
+  static_assert(N > 0 && N <= TINY_GSM_MUX_COUNT,
+                "TinyGsmConnectionPool: N must be 1..TINY_GSM_MUX_COUNT");
+
+public:
+  typedef typename Modem::GsmClient Client;
+
+  TinyGsmConnectionPool(Modem& modem, uint8_t firstMux = 0) {
+    count = 0;
+    if (firstMux < TINY_GSM_MUX_COUNT) {
+      count = TinyGsmMin(N, (uint8_t)(TINY_GSM_MUX_COUNT - firstMux));
+    }
+    if (count < N) {
+      DBG("### Pool: only", count, "slots fit from mux", firstMux);
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      slots[i].client.init(&modem, firstMux + i);
+      slots[i].host[0] = '\0';
+      slots[i].port = 0;
+      slots[i].in_use = false;
+      slots[i].last_used = 0;
+    }
+  }
+
+  // Returns a connected client for host:port, or NULL if connecting failed
+  // or all slots are in use.
+  Client* acquire(const char* host, uint16_t port) {
+    if (host == NULL || strlen(host) >= TINY_GSM_POOL_HOST_LEN) {
+      return NULL;
+    }
+
+    // Reuse an idle connection to the same endpoint
+    for (uint8_t i = 0; i < count; i++) {
+      Slot& s = slots[i];
+      if (s.in_use || s.port != port || strcmp(s.host, host) != 0) {
+        continue;
+      }
+      // Leftover bytes mean the previous exchange was not fully read,
+      // so the stream can't be trusted for a new request
+      if (s.client.connected() && !s.client.available()) {
+        DBG("### Pool reuse:", host, port, "slot", i);
+        s.in_use = true;
+        s.last_used = millis();
+        return &s.client;
+      }
+      s.client.stop();
+      s.host[0] = '\0';
+      s.port = 0;
+    }
+
+    // Prefer a free slot, otherwise evict the least recently used idle one
+    Slot* victim = NULL;
+    for (uint8_t i = 0; i < count; i++) {
+      Slot& s = slots[i];
+      if (s.in_use) {
+        continue;
+      }
+      if (!s.port || !s.client.connected()) {
+        victim = &s;
+        break;
+      }
+      if (!victim || (millis() - s.last_used) > (millis() - victim->last_used)) {
+        victim = &s;
+      }
+    }
+    if (!victim) {
+      return NULL;
+    }
+
+    victim->host[0] = '\0';
+    victim->port = 0;
+    if (!victim->client.connect(host, port)) {
+      return NULL;
+    }
+    strcpy(victim->host, host);
+    victim->port = port;
+    victim->in_use = true;
+    victim->last_used = millis();
+    return &victim->client;
+  }
+
+  // Hands a client back, keeping the connection open for reuse
+  void release(Client* client) {
+    Slot* s = find(client);
+    if (s) {
+      s->in_use = false;
+      s->last_used = millis();
+    }
+  }
+
+  // Hands a client back and closes it, e.g. after "Connection: close"
+  void discard(Client* client) {
+    Slot* s = find(client);
+    if (s) {
+      s->client.stop();
+      s->host[0] = '\0';
+      s->port = 0;
+      s->in_use = false;
+    }
+  }
+
+  // Closes idle connections that have not been used for maxIdleMs
+  void closeIdle(uint32_t maxIdleMs) {
+    for (uint8_t i = 0; i < count; i++) {
+      Slot& s = slots[i];
+      if (!s.in_use && s.port && millis() - s.last_used >= maxIdleMs) {
+        s.client.stop();
+        s.host[0] = '\0';
+        s.port = 0;
+      }
+    }
+  }
+
+  uint8_t idleCount() {
+    uint8_t res = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      if (!slots[i].in_use && slots[i].port) res++;
+    }
+    return res;
+  }
+
+private:
+  struct Slot {
+    Client    client;
+    char      host[TINY_GSM_POOL_HOST_LEN];
+    uint16_t  port;
+    bool      in_use;
+    uint32_t  last_used;
+  };
+
+  Slot* find(Client* client) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (&slots[i].client == client) return &slots[i];
+    }
+    return NULL;
+  }
+
+  Slot    slots[N];
+  uint8_t count;
+};
+
+#endif
@@ -0,0 +1,504 @@
+/**
+ * @file       TinyGsmDownloader.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmDownloader_h
+#define TinyGsmDownloader_h
+
+#include <TinyGsmHttpClient.h>
+
+#if defined(__AVR__)
+  #define TINY_GSM_READ_DWORD(p) pgm_read_dword(p)
+#else
+  #define TINY_GSM_READ_DWORD(p) (*(p))
+#endif
+
+/*
+ * CRC-32 (IEEE 802.3, same as zlib/PNG/CRC32 Arduino library),
+ * one table lookup per byte
+ */
+class TinyGsmCrc32
+{
+public:
+  TinyGsmCrc32() {
+    reset();
+  }
+
+  void reset() {
+    crc = 0xFFFFFFFF;
+  }
+
+  void update(const uint8_t* data, size_t len) {
+    uint32_t c = crc;
+    while (len--) {
+      c = TINY_GSM_READ_DWORD(&table()[(c ^ *data++) & 0xFF]) ^ (c >> 8);
+    }
+    crc = c;
+  }
+
+  uint32_t finalize() const {
+    return crc ^ 0xFFFFFFFF;
+  }
+
+private:
+  static const uint32_t* table() {
+    static const uint32_t t[256] TINY_GSM_PROGMEM = {
+      0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+      0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+      0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+      0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+      0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+      0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+      0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+      0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+      0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+      0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+      0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+      0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+      0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+      0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+      0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+      0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+      0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+      0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+      0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+      0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+      0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+      0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+      0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+      0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+      0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+      0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+      0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+      0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+      0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+      0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+      0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+      0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D,
+    };
+    return t;
+  }
+
+  uint32_t crc;
+};
+
+#if defined(TINY_GSM_DOWNLOAD_SHA256)
+
+/*
+ * SHA-256 (FIPS 180-4), processes input in 64-byte blocks.
+ * Only compiled in with TINY_GSM_DOWNLOAD_SHA256, it costs ~110 bytes of RAM.
+ */
+class TinyGsmSha256
+{
+public:
+  TinyGsmSha256() {
+    reset();
+  }
+
+  void reset() {
+    static const uint32_t init[8] TINY_GSM_PROGMEM = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    for (int i = 0; i < 8; i++) {
+      h[i] = TINY_GSM_READ_DWORD(&init[i]);
+    }
+    total = 0;
+    used = 0;
+  }
+
+  void update(const uint8_t* data, size_t len) {
+    total += len;
+    while (len) {
+      size_t n = TinyGsmMin(len, (size_t)(64 - used));
+      memcpy(block + used, data, n);
+      used += n;
+      data += n;
+      len -= n;
+      if (used == 64) {
+        transform();
+        used = 0;
+      }
+    }
+  }
+
+  void finalize(uint8_t digest[32]) {
+    uint64_t bits = total * 8;
+    block[used++] = 0x80;
+    if (used > 56) {
+      memset(block + used, 0, 64 - used);
+      transform();
+      used = 0;
+    }
+    memset(block + used, 0, 56 - used);
+    for (int i = 0; i < 8; i++) {
+      block[63 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    transform();
+    for (int i = 0; i < 8; i++) {
+      digest[4*i]   = h[i] >> 24;
+      digest[4*i+1] = h[i] >> 16;
+      digest[4*i+2] = h[i] >> 8;
+      digest[4*i+3] = h[i];
+    }
+  }
+
+private:
+  static uint32_t ror(uint32_t x, uint8_t n) {
+    return (x >> n) | (x << (32 - n));
+  }
+
+  void transform() {
+    static const uint32_t k[64] TINY_GSM_PROGMEM = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+    // Message schedule kept as a rolling 16-word window to save RAM
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (uint32_t)block[4*i] << 24 | (uint32_t)block[4*i+1] << 16 |
+             (uint32_t)block[4*i+2] << 8 | block[4*i+3];
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3],
+             e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++) {
+      if (i >= 16) {
+        uint32_t w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+        uint32_t s0 = ror(w15, 7) ^ ror(w15, 18) ^ (w15 >> 3);
+        uint32_t s1 = ror(w2, 17) ^ ror(w2, 19) ^ (w2 >> 10);
+        w[i & 15] += s0 + w[(i - 7) & 15] + s1;
+      }
+      uint32_t t1 = hh + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) +
+                    TINY_GSM_READ_DWORD(&k[i]) + w[i & 15];
+      uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      hh = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+  }
+
+  uint32_t h[8];
+  uint64_t total;
+  uint8_t  block[64];
+  uint8_t  used;
+};
+
+#endif
+
+// Receives the file in order. `offset` goes back to 0 if the server
+// ignored the Range request and the download had to start over.
+// Return false to abort.
+typedef bool (*TinyGsmDownloadSink)(uint32_t offset, const uint8_t* data, size_t len, void* arg);
+
+// Extra connections addStream() accepts
+#if !defined(TINY_GSM_DOWNLOAD_MAX_STREAMS)
+  #define TINY_GSM_DOWNLOAD_MAX_STREAMS 3
+#endif
+
+// Files smaller than this per stream are fetched over a single connection
+#if !defined(TINY_GSM_DOWNLOAD_MIN_SEGMENT)
+  #define TINY_GSM_DOWNLOAD_MIN_SEGMENT 4096
+#endif
+
+/*
+ * Downloads one HTTP resource into a sink, computing CRC-32 (and SHA-256
+ * with TINY_GSM_DOWNLOAD_SHA256) on the fly.
+ *
+ * When the connection drops, the transfer continues from the last byte
+ * handed to the sink with a "Range: bytes=<offset>-" request instead of
+ * starting over. resume() does the same after the application itself
+ * had to give up (e.g. to re-attach GPRS).
+ *
+ *   TinyGsmDownloader dl(client, "example.com");
+ *   if (dl.download("/fw.bin", writeFlash) && dl.crc32() == knownCRC32) ...
+ *
+ * With clients on other muxes added by addStream(), the file is split into
+ * one byte range per connection and all ranges are requested up front.
+ * The ranges are still read one after another, so the sink and the hashes
+ * see the data in order, but the server keeps sending on all connections
+ * meanwhile and the modem buffers it. This hides the per-connection round
+ * trips and TCP slow start, which dominate on high latency links.
+ */
+class TinyGsmDownloader
+{
+public:
+  TinyGsmDownloader(Client& client, const char* host, uint16_t port = 80)
+    : http(client, host, port), primary(client)
+  {
+    retries = 5;
+    sink = NULL;
+    sink_arg = NULL;
+    stream_count = 0;
+    reset();
+  }
+
+  // How many times to reconnect and resume before giving up
+  void setRetries(uint8_t n) {
+    retries = n;
+  }
+
+  void setTimeout(uint32_t ms) {
+    http.setTimeout(ms);
+  }
+
+  // Adds a connection (on a free mux) for segmented downloads
+  bool addStream(Client& client) {
+    if (stream_count >= TINY_GSM_DOWNLOAD_MAX_STREAMS) {
+      return false;
+    }
+    streams[stream_count++] = &client;
+    return true;
+  }
+
+  bool download(const char* path, TinyGsmDownloadSink sink, void* arg = NULL) {
+    reset();
+    this->sink = sink;
+    this->sink_arg = arg;
+    http.onHeader(onHeader, this);
+    uint8_t n = stream_count ? segments(path) : 0;
+    if (n > 1) {
+      // Failures past this point are not a reason to start over
+      return fetchSegmented(path, n);
+    }
+    return fetch(path, 0);
+  }
+
+  // Continues from offset() with the hash state kept so far
+  bool resume(const char* path, TinyGsmDownloadSink sink, void* arg = NULL) {
+    this->sink = sink;
+    this->sink_arg = arg;
+    http.onHeader(onHeader, this);
+    return fetch(path, 0);
+  }
+
+  // Bytes delivered to the sink so far
+  uint32_t offset() {
+    return received;
+  }
+
+  // Size of the whole file, 0 if unknown
+  uint32_t size() {
+    return total;
+  }
+
+  // HTTP status of the last response, or a negative TinyGsmHttpError
+  int lastError() {
+    return last_error;
+  }
+
+  uint32_t crc32() {
+    return crc.finalize();
+  }
+
+#if defined(TINY_GSM_DOWNLOAD_SHA256)
+  // Call once the download is complete
+  void sha256(uint8_t digest[32]) {
+    sha.finalize(digest);
+  }
+#endif
+
+protected:
+  void reset() {
+    received = 0;
+    total = 0;
+    ranges = false;
+    last_error = 0;
+    crc.reset();
+#if defined(TINY_GSM_DOWNLOAD_SHA256)
+    sha.reset();
+#endif
+  }
+
+  // Fetches [received, last] on the current client (or up to the end of
+  // the file if last is 0), reconnecting and resuming on errors
+  bool fetch(const char* path, uint32_t last) {
+    for (uint8_t attempt = 0; attempt <= retries; attempt++) {
+      if (attempt) {
+        DBG("### Download resume at", received, "try", attempt);
+        http.stop();
+      }
+
+      char range[40];
+      bool useRange = received || last;
+      if (useRange) {
+        makeRange(range, received, last);
+      }
+      restarted = false;
+      last_error = http.get(path, onBody, this, useRange ? range : NULL);
+
+      if (last_error == 200 || last_error == 206) {
+        if (last ? received > last : (!total || received >= total)) {
+          return true;
+        }
+        // Short body, server or link dropped it: resume
+        continue;
+      }
+      if (last_error == 416 && total && received == total) {
+        return true;
+      }
+      if (last_error > 0 || last_error == HTTP_ABORTED) {
+        // HTTP error or the sink refused the data, retrying won't help
+        http.stop();
+        return false;
+      }
+    }
+    http.stop();
+    return false;
+  }
+
+  // Asks for the size with a HEAD request, returns how many segments to
+  // split the file into, 0 or 1 if the server can't do ranges
+  uint8_t segments(const char* path) {
+    last_error = http.request("HEAD", path, NULL, NULL, 0, NULL, NULL);
+    if (last_error != 200 || !total || !ranges) {
+      return 0;
+    }
+    uint8_t n = stream_count + 1;
+    while (n > 1 && total / n < TINY_GSM_DOWNLOAD_MIN_SEGMENT) {
+      n--;
+    }
+    return n;
+  }
+
+  // Returns false if a segment failed for good, the sink aborted or the
+  // server answered with an HTTP error
+  bool fetchSegmented(const char* path, uint8_t n) {
+    uint32_t seg = (total + n - 1) / n;
+    DBG("### Download in", n, "segments of", seg);
+
+    // Request every segment before reading any of them
+    bool sent[TINY_GSM_DOWNLOAD_MAX_STREAMS + 1];
+    for (uint8_t i = 0; i < n; i++) {
+      char range[40];
+      makeRange(range, i * seg, TinyGsmMin(total, (i + 1) * seg) - 1);
+      http.setClient(stream(i));
+      sent[i] = http.sendRequest("GET", path, NULL, NULL, 0, range) == 0;
+    }
+
+    bool ok = true;
+    for (uint8_t i = 0; i < n && ok; i++) {
+      uint32_t first = i * seg;
+      uint32_t last = TinyGsmMin(total, (i + 1) * seg) - 1;
+      if (received != first) {
+        // A segment restarted from 0 and already got past this one
+        ok = received > last;
+        continue;
+      }
+      http.setClient(stream(i));
+      restarted = false;
+      last_error = sent[i] ? http.readResponse(onBody, this) : HTTP_SEND_FAILED;
+      if ((last_error == 200 || last_error == 206) && received > last) {
+        continue;
+      }
+      if (last_error == HTTP_ABORTED || (last_error > 0 && last_error != 206)) {
+        ok = false;
+        break;
+      }
+      // Dropped or short, carry on with this segment alone
+      ok = fetch(path, last);
+    }
+
+    for (uint8_t i = 1; i < n; i++) {
+      stream(i).stop();
+    }
+    http.setClient(primary);
+    return ok && received >= total;
+  }
+
+  Client& stream(uint8_t i) {
+    return i ? *streams[i - 1] : primary;
+  }
+
+  static void makeRange(char* out, uint32_t first, uint32_t last) {
+    strcpy(out, "Range: bytes=");
+    out += strlen(out);
+    out = ultoa10(first, out);
+    *out++ = '-';
+    if (last) {
+      out = ultoa10(last, out);
+    }
+    strcpy(out, "\r\n");
+  }
+
+  static void onHeader(const char* name, const char* value, void* arg) {
+    TinyGsmDownloader* self = (TinyGsmDownloader*)arg;
+    int status = self->http.responseStatus();
+    if (status == 200 && TinyGsmHttpClient::equalsIgnoreCase(name, "Content-Length")) {
+      self->total = strtoul(value, NULL, 10);
+    } else if (status == 200 && TinyGsmHttpClient::equalsIgnoreCase(name, "Accept-Ranges")) {
+      self->ranges = TinyGsmHttpClient::equalsIgnoreCase(value, "bytes");
+    } else if (status == 206 && TinyGsmHttpClient::equalsIgnoreCase(name, "Content-Range")) {
+      // "bytes 1000-1999/2000"
+      const char* slash = strchr(value, '/');
+      if (slash && slash[1] != '*') {
+        self->total = strtoul(slash + 1, NULL, 10);
+      }
+    }
+  }
+
+  static bool onBody(const uint8_t* data, size_t len, void* arg) {
+    TinyGsmDownloader* self = (TinyGsmDownloader*)arg;
+    if (!self->restarted && self->received && self->http.responseStatus() == 200) {
+      // Range was ignored, we are getting the file from the start again
+      DBG("### Download restarted from 0");
+      uint32_t size = self->total;
+      self->reset();
+      self->total = size;
+    }
+    self->restarted = true;
+
+    if (!self->sink(self->received, data, len, self->sink_arg)) {
+      return false;
+    }
+    self->crc.update(data, len);
+#if defined(TINY_GSM_DOWNLOAD_SHA256)
+    self->sha.update(data, len);
+#endif
+    self->received += len;
+    return true;
+  }
+
+  // Returns the end of the written digits
+  static char* ultoa10(uint32_t val, char* out) {
+    char tmp[11];
+    char* p = tmp + sizeof(tmp) - 1;
+    *p = '\0';
+    do {
+      *--p = '0' + (val % 10);
+      val /= 10;
+    } while (val);
+    strcpy(out, p);
+    return out + strlen(out);
+  }
+
+protected:
+  TinyGsmHttpClient   http;
+  Client&             primary;
+  Client*             streams[TINY_GSM_DOWNLOAD_MAX_STREAMS];
+  uint8_t             stream_count;
+  TinyGsmDownloadSink sink;
+  void*               sink_arg;
+  uint8_t             retries;
+  bool                restarted;
+  bool                ranges;
+  int                 last_error;
+  uint32_t            received;
+  uint32_t            total;
+  TinyGsmCrc32        crc;
+#if defined(TINY_GSM_DOWNLOAD_SHA256)
+  TinyGsmSha256       sha;
+#endif
+};
+
+#endif
@@ -0,0 +1,431 @@
+/**
+ * @file       TinyGsmHttpClient.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmHttpClient_h
+#define TinyGsmHttpClient_h
+
+#include <TinyGsmCommon.h>
+
+// Scratch buffer used both for assembling the request and for reading the
+// response. Matching the client RX FIFO lets every read() drain it at once.
+#if !defined(TINY_GSM_HTTP_BUFFER)
+  #if defined(TINY_GSM_RX_BUFFER)
+    #define TINY_GSM_HTTP_BUFFER TINY_GSM_RX_BUFFER
+  #else
+    #define TINY_GSM_HTTP_BUFFER 64
+  #endif
+#endif
+
+// Longest status/header/chunk-size line kept, the rest is cut off
+#if !defined(TINY_GSM_HTTP_LINE_LEN)
+  #define TINY_GSM_HTTP_LINE_LEN 96
+#endif
+
+enum TinyGsmHttpError {
+  HTTP_CONNECT_FAILED   = -1,
+  HTTP_SEND_FAILED      = -2,
+  HTTP_TIMED_OUT        = -3,
+  HTTP_INVALID_RESPONSE = -4,
+  HTTP_ABORTED          = -5,
+};
+
+// Receives the body as it arrives, return false to abort the transfer
+typedef bool (*TinyGsmHttpBodyCallback)(const uint8_t* data, size_t len, void* arg);
+
+// Receives every response header, both strings are only valid during the call
+typedef void (*TinyGsmHttpHeaderCallback)(const char* name, const char* value, void* arg);
+
+/*
+ * A small HTTP/1.1 client on top of any Client (usually a TinyGsmClient).
+ *
+ * The connection is kept open between requests unless the server asks to
+ * close it. Headers are parsed in place in a fixed line buffer and the body
+ * (plain, Content-Length or chunked) is passed to a callback in blocks,
+ * so nothing is allocated on the heap.
+ *
+ *   TinyGsmHttpClient http(client, "example.com");
+ *   int status = http.get("/data.bin", onBody);
+ */
+class TinyGsmHttpClient
+{
+public:
+  TinyGsmHttpClient(Client& client, const char* host, uint16_t port = 80)
+    : client(&client), host(host), port(port)
+  {
+    timeout_ms = 30000L;
+    header_cb = NULL;
+    header_arg = NULL;
+    status = 0;
+    content_length = -1;
+    chunked = false;
+    keep_alive = false;
+    no_body = false;
+    rx_pos = rx_len = 0;
+  }
+
+  void setTimeout(uint32_t ms) {
+    timeout_ms = ms;
+  }
+
+  void onHeader(TinyGsmHttpHeaderCallback cb, void* arg = NULL) {
+    header_cb = cb;
+    header_arg = arg;
+  }
+
+  int get(const char* path, TinyGsmHttpBodyCallback cb = NULL, void* arg = NULL,
+          const char* extraHeaders = NULL) {
+    return request("GET", path, NULL, NULL, 0, cb, arg, extraHeaders);
+  }
+
+  int post(const char* path, const char* contentType, const void* body, size_t len,
+           TinyGsmHttpBodyCallback cb = NULL, void* arg = NULL,
+           const char* extraHeaders = NULL) {
+    return request("POST", path, contentType, body, len, cb, arg, extraHeaders);
+  }
+
+  // Sends one request and streams the response body to cb.
+  // extraHeaders, if given, must be complete lines ending with "\r\n".
+  // Returns the HTTP status code, or a negative TinyGsmHttpError.
+  int request(const char* method, const char* path,
+              const char* contentType, const void* body, size_t len,
+              TinyGsmHttpBodyCallback cb, void* arg,
+              const char* extraHeaders = NULL)
+  {
+    // A kept-alive connection may have been closed by the server meanwhile,
+    // in that case retry once on a fresh connection
+    for (int attempt = 0; attempt < 2; attempt++) {
+      bool reused = client->connected();
+      int res = sendRequest(method, path, contentType, body, len, extraHeaders);
+      if (res == HTTP_SEND_FAILED && reused) {
+        continue;
+      }
+      if (res < 0) {
+        return res;
+      }
+      res = readResponse(cb, arg);
+      if (res == HTTP_TIMED_OUT && reused && !status) {
+        continue;
+      }
+      return res;
+    }
+    return HTTP_CONNECT_FAILED;
+  }
+
+  // First half of request(): connects if needed and sends the request
+  // without waiting for the answer, so that requests on several clients
+  // can be in flight at the same time. Returns 0 or a TinyGsmHttpError.
+  int sendRequest(const char* method, const char* path,
+                  const char* contentType = NULL, const void* body = NULL, size_t len = 0,
+                  const char* extraHeaders = NULL)
+  {
+    if (!client->connected() && !client->connect(host, port)) {
+      return HTTP_CONNECT_FAILED;
+    }
+    rx_pos = rx_len = 0;
+    status = 0;
+    no_body = (strcmp(method, "HEAD") == 0);
+    if (!sendHead(method, path, contentType, body, len, extraHeaders)) {
+      client->stop();
+      return HTTP_SEND_FAILED;
+    }
+    return 0;
+  }
+
+  // Second half of request(): reads the answer to sendRequest()
+  int readResponse(TinyGsmHttpBodyCallback cb = NULL, void* arg = NULL) {
+    int res = readStatusAndHeaders();
+    if (res < 0) {
+      client->stop();
+      return res;
+    }
+    if (!no_body && status != 204 && status != 304) {
+      res = readBody(cb, arg);
+      if (res < 0) {
+        client->stop();
+        return res;
+      }
+    }
+    if (!keep_alive) {
+      client->stop();
+    }
+    return status;
+  }
+
+  // Switches to another connection to the same host, the buffer is shared.
+  // Only call this between complete requests.
+  void setClient(Client& c) {
+    client = &c;
+    rx_pos = rx_len = 0;
+  }
+
+  void stop() {
+    client->stop();
+  }
+
+  int responseStatus() {
+    return status;
+  }
+
+  // -1 if the server didn't send it
+  int32_t contentLength() {
+    return content_length;
+  }
+
+  bool isChunked() {
+    return chunked;
+  }
+
+  bool isKeepAlive() {
+    return keep_alive;
+  }
+
+  static bool equalsIgnoreCase(const char* a, const char* b) {
+    while (*a && *b) {
+      if (tolower(*a++) != tolower(*b++)) return false;
+    }
+    return *a == *b;
+  }
+
+protected:
+
+  /*
+   * Request
+   */
+
+  bool sendHead(const char* method, const char* path, const char* contentType,
+                const void* body, size_t len, const char* extraHeaders)
+  {
+    tx_len = 0;
+    tx_ok = true;
+    txAppend(method); txAppend(" "); txAppend(path); txAppend(" HTTP/1.1\r\n");
+    txAppend("Host: "); txAppend(host); txAppend("\r\n");
+    if (body || contentType) {
+      if (contentType) {
+        txAppend("Content-Type: "); txAppend(contentType); txAppend("\r\n");
+      }
+      txAppend("Content-Length: "); txAppend((uint32_t)len); txAppend("\r\n");
+    }
+    if (extraHeaders) {
+      txAppend(extraHeaders);
+    }
+    txAppend("\r\n");
+    if (!tx_ok) {
+      return false;
+    }
+
+    // Small bodies go out together with the headers in one send
+    if (body && len <= sizeof(buf) - tx_len) {
+      memcpy(buf + tx_len, body, len);
+      tx_len += len;
+      return txFlush();
+    }
+    if (!txFlush()) {
+      return false;
+    }
+    if (body && len) {
+      return client->write((const uint8_t*)body, len) == len;
+    }
+    return true;
+  }
+
+  void txAppend(const char* str) {
+    while (*str) {
+      if (tx_len == sizeof(buf)) {
+        txFlush();
+      }
+      buf[tx_len++] = *str++;
+    }
+  }
+
+  void txAppend(uint32_t val) {
+    char tmp[11];
+    char* p = tmp + sizeof(tmp) - 1;
+    *p = '\0';
+    do {
+      *--p = '0' + (val % 10);
+      val /= 10;
+    } while (val);
+    txAppend(p);
+  }
+
+  bool txFlush() {
+    if (tx_len && client->write(buf, tx_len) != tx_len) {
+      tx_ok = false;
+    }
+    tx_len = 0;
+    return tx_ok;
+  }
+
+  /*
+   * Response
+   */
+
+  int readStatusAndHeaders() {
+    do {
+      if (!readLine()) {
+        return HTTP_TIMED_OUT;
+      }
+      // "HTTP/1.1 200 OK", the reason phrase is optional
+      if (strlen(line) < 12 || strncmp(line, "HTTP/1.", 7) != 0 ||
+          line[8] != ' ' || !isdigit(line[9])) {
+        return HTTP_INVALID_RESPONSE;
+      }
+      bool http10 = (line[7] == '0');
+      status = atoi(line + 9);
+      content_length = -1;
+      chunked = false;
+      keep_alive = !http10;
+
+      for (;;) {
+        if (!readLine()) {
+          return HTTP_TIMED_OUT;
+        }
+        if (!line[0]) {
+          break;
+        }
+        char* value = strchr(line, ':');
+        if (!value) {
+          continue;
+        }
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t') value++;
+
+        if (equalsIgnoreCase(line, "Content-Length")) {
+          content_length = atol(value);
+        } else if (equalsIgnoreCase(line, "Transfer-Encoding")) {
+          chunked = equalsIgnoreCase(value, "chunked");
+        } else if (equalsIgnoreCase(line, "Connection")) {
+          if (equalsIgnoreCase(value, "close")) {
+            keep_alive = false;
+          } else if (equalsIgnoreCase(value, "keep-alive")) {
+            keep_alive = true;
+          }
+        }
+        if (header_cb) {
+          header_cb(line, value, header_arg);
+        }
+      }
+    } while (status >= 100 && status < 200); // Skip "100 Continue" and friends
+
+    return status;
+  }
+
+  int readBody(TinyGsmHttpBodyCallback cb, void* arg) {
+    if (chunked) {
+      for (;;) {
+        // "<hex size>[;extensions]"
+        if (!readLine()) {
+          return HTTP_TIMED_OUT;
+        }
+        char* end;
+        uint32_t size = strtoul(line, &end, 16);
+        if (end == line) {
+          return HTTP_INVALID_RESPONSE;
+        }
+        if (size == 0) {
+          // Skip optional trailers
+          do {
+            if (!readLine()) {
+              return HTTP_TIMED_OUT;
+            }
+          } while (line[0]);
+          return 0;
+        }
+        int res = streamBody(size, cb, arg);
+        if (res < 0) {
+          return res;
+        }
+        if (!readLine()) { // CRLF after chunk data
+          return HTTP_TIMED_OUT;
+        }
+      }
+    } else if (content_length >= 0) {
+      return streamBody(content_length, cb, arg);
+    }
+    // No length given, the body ends when the server closes the connection
+    keep_alive = false;
+    int res = streamBody(0xFFFFFFFF, cb, arg);
+    return (res == HTTP_TIMED_OUT && !client->connected()) ? 0 : res;
+  }
+
+  // Hands buffered data straight to the callback, no extra copy
+  int streamBody(uint32_t len, TinyGsmHttpBodyCallback cb, void* arg) {
+    while (len) {
+      if (rx_pos >= rx_len && !fill()) {
+        return HTTP_TIMED_OUT;
+      }
+      size_t chunk = TinyGsmMin((uint32_t)(rx_len - rx_pos), len);
+      if (cb && !cb(buf + rx_pos, chunk, arg)) {
+        return HTTP_ABORTED;
+      }
+      rx_pos += chunk;
+      len -= chunk;
+    }
+    return 0;
+  }
+
+  // Reads a line without CR/LF into `line`, overlong lines are truncated
+  bool readLine() {
+    size_t len = 0;
+    for (;;) {
+      if (rx_pos >= rx_len && !fill()) {
+        return false;
+      }
+      char c = buf[rx_pos++];
+      if (c == '\n') break;
+      if (c == '\r') continue;
+      if (len < sizeof(line) - 1) {
+        line[len++] = c;
+      }
+    }
+    line[len] = '\0';
+    return true;
+  }
+
+  // Refills the whole buffer with a single client read
+  bool fill() {
+    rx_pos = rx_len = 0;
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms) {
+      int n = client->read(buf, sizeof(buf));
+      if (n > 0) {
+        rx_len = n;
+        return true;
+      }
+      if (!client->connected()) {
+        return false;
+      }
+      TINY_GSM_YIELD();
+    }
+    return false;
+  }
+
+protected:
+  Client*       client;
+  const char*   host;
+  uint16_t      port;
+  uint32_t      timeout_ms;
+
+  TinyGsmHttpHeaderCallback header_cb;
+  void*         header_arg;
+
+  int           status;
+  int32_t       content_length;
+  bool          chunked;
+  bool          keep_alive;
+  bool          no_body;
+
+  uint8_t       buf[TINY_GSM_HTTP_BUFFER];
+  uint16_t      rx_pos;
+  uint16_t      rx_len;
+  uint16_t      tx_len;
+  bool          tx_ok;
+  char          line[TINY_GSM_HTTP_LINE_LEN];
+};
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file       TinyGsmMqtt.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmMqtt_h
+#define TinyGsmMqtt_h
+
+#include <TinyGsmCommon.h>
+
+// Longer topics are cut off
+#if !defined(TINY_GSM_MQTT_TOPIC_LEN)
+  #define TINY_GSM_MQTT_TOPIC_LEN 64
+#endif
+
+// Longer payloads are cut off
+#if !defined(TINY_GSM_MQTT_PAYLOAD_LEN)
+  #define TINY_GSM_MQTT_PAYLOAD_LEN 128
+#endif
+
+typedef void (*TinyGsmMqttCallback)(const char* topic, const uint8_t* payload, size_t len, void* arg);
+
+/*
+ * MQTT client that runs on the modem's own MQTT stack (SIM7000, BG96).
+ * The modem sends keepalive pings by itself, so the MCU only needs to
+ * talk to it to publish and to pick up received messages.
+ *
+ *   TinyGsm::Mqtt mqtt(modem);
+ *   mqtt.onMessage(callback);
+ *   mqtt.connect("broker.example.com", 1883, "unit1");
+ *   mqtt.subscribe("unit1/cmd");
+ *   mqtt.publish("unit1/temp", "21.5");
+ *   ...
+ *   mqtt.loop();
+ *
+ * Incoming messages are parsed from URCs into a single slot and delivered
+ * by loop(), so the callback can publish safely. A message that arrives
+ * before the previous one was delivered replaces it, droppedMessages()
+ * counts how often that happened.
+ */
+class TinyGsmMqtt
+{
+public:
+  TinyGsmMqtt() {
+    callback = NULL;
+    callback_arg = NULL;
+    keepalive_s = 60;
+    msg_pending = false;
+    msg_dropped = 0;
+    msg_len = 0;
+    msg_topic[0] = '\0';
+  }
+
+  virtual ~TinyGsmMqtt() {}
+
+  virtual bool connect(const char* host, uint16_t port, const char* clientId,
+                       const char* user = NULL, const char* pass = NULL) = 0;
+
+  virtual void disconnect() = 0;
+
+  virtual bool connected() = 0;
+
+  // Hands the message to the modem. Where the modem reports the outcome
+  // later (BG96) this returns without waiting for the broker, so several
+  // publishes go out back to back, see flush(). Where the AT command only
+  // completes once the message is out (SIM7000) this blocks until then.
+  virtual bool publish(const char* topic, const void* payload, size_t len,
+                       uint8_t qos = 0, bool retain = false) = 0;
+
+  bool publish(const char* topic, const char* payload,
+               uint8_t qos = 0, bool retain = false) {
+    return publish(topic, payload, strlen(payload), qos, retain);
+  }
+
+  // Waits until the modem has reported every publish as done.
+  // Returns false if any of them failed or timed out.
+  virtual bool flush(uint32_t /*timeout_ms*/ = 10000L) {
+    return true;
+  }
+
+  virtual bool subscribe(const char* topic, uint8_t qos = 0) = 0;
+
+  virtual bool unsubscribe(const char* topic) = 0;
+
+  // Applies on the next connect()
+  void setKeepAlive(uint16_t seconds) {
+    keepalive_s = seconds;
+  }
+
+  void onMessage(TinyGsmMqttCallback cb, void* arg = NULL) {
+    callback = cb;
+    callback_arg = arg;
+  }
+
+  // Messages replaced before loop() could deliver them
+  uint16_t droppedMessages() {
+    return msg_dropped;
+  }
+
+  // Processes URCs and delivers a received message, if any
+  virtual void loop() {
+    poll();
+    if (msg_pending) {
+      msg_pending = false;
+      if (callback) {
+        callback(msg_topic, msg_payload, msg_len, callback_arg);
+      }
+    }
+  }
+
+protected:
+  virtual void poll() = 0;
+
+  // For URCs that give the payload length
+  void readMessage(const String& topic, Stream& stream, size_t len) {
+    storeTopic(topic);
+    msg_len = stream.readBytes(msg_payload, TinyGsmMin(len, sizeof(msg_payload)));
+    len -= msg_len;
+    while (len) {
+      uint8_t skip[16];
+      size_t n = stream.readBytes(skip, TinyGsmMin(len, sizeof(skip)));
+      if (!n) break;
+      len -= n;
+    }
+    msg_pending = true;
+  }
+
+  // For URCs where the quoted payload runs to the end of the line
+  void readMessageLine(const String& topic, Stream& stream) {
+    storeTopic(topic);
+    size_t len = stream.readBytesUntil('\n', (char*)msg_payload, sizeof(msg_payload));
+    if (len == sizeof(msg_payload)) {
+      char skip[16];
+      while (stream.readBytesUntil('\n', skip, sizeof(skip)) == sizeof(skip)) {}
+    } else {
+      // Strip the closing quote and CR
+      while (len && msg_payload[len-1] == '\r') len--;
+      if (len && msg_payload[len-1] == '"') len--;
+    }
+    msg_len = len;
+    msg_pending = true;
+  }
+
+  void storeTopic(const String& topic) {
+    if (msg_pending) {
+      msg_dropped++;
+      DBG("### MQTT message dropped:", msg_topic);
+    }
+    strncpy(msg_topic, topic.c_str(), sizeof(msg_topic) - 1);
+    msg_topic[sizeof(msg_topic) - 1] = '\0';
+  }
+
+  TinyGsmMqttCallback callback;
+  void*         callback_arg;
+  uint16_t      keepalive_s;
+
+  bool          msg_pending;
+  uint16_t      msg_dropped;
+  size_t        msg_len;
+  char          msg_topic[TINY_GSM_MQTT_TOPIC_LEN];
+  uint8_t       msg_payload[TINY_GSM_MQTT_PAYLOAD_LEN];
+};
+
+#endif
@@ -0,0 +1,376 @@
+/**
+ * @file       TinyGsmPdu.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmPdu_h
+#define TinyGsmPdu_h
+
+#include <TinyGsmCommon.h>
+
+/*
+ * SMS PDU codec (3GPP TS 23.040), for modems kept in PDU mode (AT+CMGF=0).
+ * Everything runs in caller buffers:
+ *
+ *   char pdu[TINY_GSM_PDU_BUFFER];
+ *   size_t len = TinyGsmPduEncodeSubmit(pdu, sizeof(pdu), "+123456789",
+ *                                       "Hello", 5, SmsAlphabet::GSM_7bit);
+ *   // AT+CMGS=<len>, then the hex in pdu, then Ctrl+Z
+ *
+ * PDUs are hex strings as the modem prints them, starting with the SMSC
+ * address. Encoded PDUs use an empty SMSC field, so the modem's default
+ * service centre (AT+CSCA) applies.
+ *
+ * GSM_7bit text is UTF-8 on the MCU side, see TinyGsmGsm7Pack().
+ */
+
+// Longest encoded PDU in hex, with the terminating NUL
+#define TINY_GSM_PDU_BUFFER 320
+
+// Longest user data of one message, in octets
+#define TINY_GSM_PDU_UD_MAX 140
+
+// TP-MTI of decoded PDUs
+#define TINY_GSM_PDU_DELIVER        0
+#define TINY_GSM_PDU_SUBMIT         1
+#define TINY_GSM_PDU_STATUS_REPORT  2
+
+// A decoded SMS-DELIVER, stored SMS-SUBMIT or SMS-STATUS-REPORT
+struct TinyGsmSmsPdu {
+  uint8_t     type;           // TINY_GSM_PDU_DELIVER, _SUBMIT or _STATUS_REPORT
+  SmsAlphabet alphabet;
+  char        sender[24];     // TP-OA, TP-DA of a submit, TP-RA of a report
+  char        timestamp[24];  // TP-SCTS as "yy/MM/dd,hh:mm:ss+zz"
+  uint16_t    concat_ref;     // Concatenated message reference
+  uint8_t     concat_total;   // Parts of the concatenated message, 0 if none
+  uint8_t     concat_seq;     // This part, starting with 1
+  uint8_t     mr;             // TP-MR of a submit or of the reported message
+  uint8_t     st;             // Status report: TP-ST, 0 if delivered
+  uint8_t*    data;           // Caller buffer for the user data, may be NULL
+  size_t      data_size;
+  size_t      length;         // UTF-8 text, octets or UTF-16BE, see alphabet
+};
+
+static inline
+void TinyGsmPduPutOctet(char*& p, uint8_t b) {
+  *p++ = TinyGsmHexDigits[b >> 4];
+  *p++ = TinyGsmHexDigits[b & 0x0F];
+}
+
+/*
+ * Encodes an SMS-SUBMIT. text is len bytes of UTF-8 (GSM_7bit), octets
+ * (Data_8bit) or len UTF-16 code units (UCS2). A non-zero concat_total adds a
+ * concatenation header for part concat_seq of concat_total.
+ * Returns the TPDU length in octets for AT+CMGS, 0 if the text doesn't
+ * fit into one message or the PDU doesn't fit into pdu_size.
+ */
+static inline
+size_t TinyGsmPduEncodeSubmit(char* pdu, size_t pdu_size, const char* number,
+                              const void* text, size_t len, SmsAlphabet alphabet,
+                              bool status_report = false, uint8_t concat_total = 0,
+                              uint8_t concat_seq = 0, uint8_t concat_ref = 0)
+{
+  uint8_t ud[TINY_GSM_PDU_UD_MAX];
+  memset(ud, 0, sizeof(ud));
+
+  size_t udh_len = concat_total ? 6 : 0;
+  if (udh_len) {
+    ud[0] = 5;     // UDHL
+    ud[1] = 0x00;  // Concatenated short message, 8-bit reference
+    ud[2] = 3;
+    ud[3] = concat_ref;
+    ud[4] = concat_total;
+    ud[5] = concat_seq;
+  }
+
+  size_t udl;      // In septets for GSM_7bit, in octets otherwise
+  size_t ud_octets;
+  uint8_t dcs;
+  if (alphabet == SmsAlphabet::GSM_7bit) {
+    // Septets start on a septet boundary after the header
+    size_t start = (udh_len * 8 + 6) / 7;
+    udl = TinyGsmGsm7Pack((const char*)text, len, ud, sizeof(ud), start);
+    if (udl == (size_t)-1) {
+      return 0;
+    }
+    ud_octets = (udl * 7 + 7) / 8;
+    dcs = 0x00;
+  } else if (alphabet == SmsAlphabet::UCS2) {
+    udl = ud_octets = udh_len + len * 2;
+    if (ud_octets > sizeof(ud)) {
+      return 0;
+    }
+    const uint16_t* t = (const uint16_t*)text;
+    for (size_t i = 0; i < len; i++) {
+      ud[udh_len + i*2]     = t[i] >> 8;
+      ud[udh_len + i*2 + 1] = t[i] & 0xFF;
+    }
+    dcs = 0x08;
+  } else if (alphabet == SmsAlphabet::Data_8bit) {
+    udl = ud_octets = udh_len + len;
+    if (ud_octets > sizeof(ud)) {
+      return 0;
+    }
+    memcpy(ud + udh_len, text, len);
+    dcs = 0x04;
+  } else {
+    return 0;
+  }
+
+  bool international = (number[0] == '+');
+  if (international) {
+    number++;
+  }
+  size_t digits = strlen(number);
+  size_t tpdu_len = 4 + (digits + 1) / 2 + 3 + ud_octets;
+  if (digits > 20 || (1 + tpdu_len) * 2 + 1 > pdu_size) {
+    return 0;
+  }
+
+  char* p = pdu;
+  TinyGsmPduPutOctet(p, 0x00);  // Default SMSC
+  // SMS-SUBMIT, no validity period
+  TinyGsmPduPutOctet(p, 0x01 | (status_report ? 0x20 : 0) | (udh_len ? 0x40 : 0));
+  TinyGsmPduPutOctet(p, 0x00);  // TP-MR, set by the modem
+  TinyGsmPduPutOctet(p, digits);
+  TinyGsmPduPutOctet(p, international ? 0x91 : 0x81);
+  for (size_t i = 0; i < digits; i += 2) {
+    // Semi-octets, swapped, padded with F
+    *p++ = (i + 1 < digits) ? number[i + 1] : 'F';
+    *p++ = number[i];
+  }
+  TinyGsmPduPutOctet(p, 0x00);  // TP-PID
+  TinyGsmPduPutOctet(p, dcs);
+  TinyGsmPduPutOctet(p, udl);
+  for (size_t i = 0; i < ud_octets; i++) {
+    TinyGsmPduPutOctet(p, ud[i]);
+  }
+  *p = '\0';
+  return tpdu_len;
+}
+
+// Reads octets from a hex string, or straight from the modem stream so a
+// listing needs no line buffer. Flags a short or malformed PDU.
+class TinyGsmPduReader
+{
+public:
+  TinyGsmPduReader(const char* hex, size_t len)
+    : hex(hex), stream(NULL), len(len), pos(0), error(false) {}
+
+  TinyGsmPduReader(Stream& stream)
+    : hex(NULL), stream(&stream), len(0), pos(0), error(false) {}
+
+  uint8_t octet() {
+    char c[2];
+    if (error) {
+      return 0;
+    }
+    if (stream) {
+      if (stream->readBytes(c, 2) != 2) {
+        error = true;
+        return 0;
+      }
+    } else {
+      if (pos + 2 > len) {
+        error = true;
+        return 0;
+      }
+      c[0] = hex[pos];
+      c[1] = hex[pos + 1];
+      pos += 2;
+    }
+    uint8_t hi = TinyGsmHexNibble(c[0]);
+    uint8_t lo = TinyGsmHexNibble(c[1]);
+    if ((hi | lo) & 0xF0) {
+      error = true;
+      return 0;
+    }
+    return (hi << 4) | lo;
+  }
+
+  void skip(size_t octets) {
+    while (octets-- && !error) {
+      octet();
+    }
+  }
+
+  // TP-OA/TP-DA/TP-RA: digits, or 7-bit packed alphanumeric
+  void address(char* out, size_t size) {
+    uint8_t digits = octet();
+    uint8_t type = octet();
+    uint8_t octets = (digits + 1) / 2;
+    size_t n = 0;
+    if ((type & 0x70) == 0x50) {
+      uint8_t packed[10];
+      if (octets > sizeof(packed)) {
+        error = true;
+        return;
+      }
+      for (uint8_t i = 0; i < octets; i++) {
+        packed[i] = octet();
+      }
+      n = TinyGsmGsm7Unpack(packed, digits * 4U / 7, 0, out, size - 1);
+    } else {
+      if (type == 0x91 && n + 1 < size) {
+        out[n++] = '+';
+      }
+      for (uint8_t i = 0; i < octets; i++) {
+        uint8_t b = octet();
+        if (n + 1 < size) out[n++] = '0' + (b & 0x0F);
+        if ((b >> 4) != 0x0F && n + 1 < size) out[n++] = '0' + (b >> 4);
+      }
+    }
+    out[n] = '\0';
+  }
+
+  // TP-SCTS as "yy/MM/dd,hh:mm:ss+zz"
+  void timestamp(char* out, size_t size) {
+    uint8_t v[7];
+    for (uint8_t i = 0; i < 7; i++) {
+      uint8_t b = octet();
+      v[i] = (b & 0x0F) * 10 + (b >> 4);
+    }
+    // Time zone in quarters of an hour, bit 3 of the first digit is the sign
+    bool negative = v[6] >= 80;
+    if (negative) {
+      v[6] -= 80;
+    }
+    snprintf(out, size, "%02u/%02u/%02u,%02u:%02u:%02u%c%02u",
+             v[0], v[1], v[2], v[3], v[4], v[5], negative ? '-' : '+', v[6]);
+  }
+
+  const char* hex;
+  Stream*     stream;
+  size_t      len;
+  size_t      pos;
+  bool        error;
+};
+
+static inline
+SmsAlphabet TinyGsmPduAlphabet(uint8_t dcs) {
+  if ((dcs & 0x80) == 0x00) {
+    // General data coding, compressed text isn't supported
+    return (dcs & 0x20) ? SmsAlphabet::Reserved : (SmsAlphabet)((dcs >> 2) & B11);
+  }
+  switch (dcs & 0xF0) {
+  case 0xC0:
+  case 0xD0: return SmsAlphabet::GSM_7bit;
+  case 0xE0: return SmsAlphabet::UCS2;
+  case 0xF0: return (dcs & 0x04) ? SmsAlphabet::Data_8bit : SmsAlphabet::GSM_7bit;
+  }
+  return SmsAlphabet::Reserved;
+}
+
+/*
+ * Decodes an SMS-DELIVER, a stored SMS-SUBMIT or an SMS-STATUS-REPORT,
+ * with the SMSC address in front as the modem prints it. The user data is
+ * written to sms.data, cut off at sms.data_size. Returns false for other
+ * PDU types and malformed PDUs.
+ */
+static inline
+bool TinyGsmPduDecode(TinyGsmPduReader& r, TinyGsmSmsPdu& sms)
+{
+  sms.sender[0] = '\0';
+  sms.timestamp[0] = '\0';
+  sms.concat_ref = 0;
+  sms.concat_total = 0;
+  sms.concat_seq = 0;
+  sms.mr = 0;
+  sms.st = 0;
+  sms.length = 0;
+  sms.alphabet = SmsAlphabet::GSM_7bit;
+
+  r.skip(r.octet());  // SMSC
+  uint8_t fo = r.octet();
+  sms.type = fo & 0x03;
+
+  if (sms.type == TINY_GSM_PDU_STATUS_REPORT) {
+    sms.mr = r.octet();
+    r.address(sms.sender, sizeof(sms.sender));
+    r.timestamp(sms.timestamp, sizeof(sms.timestamp));
+    r.skip(7);  // TP-DT
+    sms.st = r.octet();
+    return !r.error;
+  } else if (sms.type == TINY_GSM_PDU_DELIVER) {
+    r.address(sms.sender, sizeof(sms.sender));
+    r.octet();  // TP-PID
+    sms.alphabet = TinyGsmPduAlphabet(r.octet());
+    r.timestamp(sms.timestamp, sizeof(sms.timestamp));
+  } else if (sms.type == TINY_GSM_PDU_SUBMIT) {
+    sms.mr = r.octet();
+    r.address(sms.sender, sizeof(sms.sender));
+    r.octet();  // TP-PID
+    sms.alphabet = TinyGsmPduAlphabet(r.octet());
+    switch ((fo >> 3) & 0x03) {  // TP-VPF
+    case 2:  r.skip(1); break;   // Relative
+    case 1:                      // Enhanced
+    case 3:  r.skip(7); break;   // Absolute
+    }
+  } else {
+    return false;
+  }
+
+  size_t udl = r.octet();
+  if (r.error || sms.alphabet == SmsAlphabet::Reserved) {
+    return false;
+  }
+
+  size_t ud_octets = (sms.alphabet == SmsAlphabet::GSM_7bit) ? (udl * 7 + 7) / 8 : udl;
+  if (ud_octets > TINY_GSM_PDU_UD_MAX) {
+    return false;
+  }
+  uint8_t ud[TINY_GSM_PDU_UD_MAX];
+  for (size_t i = 0; i < ud_octets; i++) {
+    ud[i] = r.octet();
+  }
+  if (r.error) {
+    return false;
+  }
+
+  size_t udh_len = 0;
+  if (fo & 0x40) {
+    udh_len = 1 + ud[0];
+    if (udh_len > ud_octets) {
+      return false;
+    }
+    for (size_t i = 1; i + 1 < udh_len && i + 2 + ud[i + 1] <= udh_len;
+         i += 2 + ud[i + 1]) {
+      uint8_t iei = ud[i];
+      const uint8_t* ie = ud + i + 2;
+      if (iei == 0x00 && ud[i + 1] == 3) {
+        sms.concat_ref = ie[0];
+        sms.concat_total = ie[1];
+        sms.concat_seq = ie[2];
+      } else if (iei == 0x08 && ud[i + 1] == 4) {
+        sms.concat_ref = (ie[0] << 8) | ie[1];
+        sms.concat_total = ie[2];
+        sms.concat_seq = ie[3];
+      }
+    }
+  }
+
+  if (sms.alphabet == SmsAlphabet::GSM_7bit) {
+    // Septets start on a septet boundary after the header
+    sms.length = TinyGsmGsm7Unpack(ud, udl, (udh_len * 8 + 6) / 7,
+                                   (char*)sms.data, sms.data ? sms.data_size : 0);
+  } else {
+    for (size_t i = udh_len; i < udl; i++) {
+      if (sms.length < sms.data_size) {
+        sms.data[sms.length++] = ud[i];
+      }
+    }
+  }
+  return true;
+}
+
+static inline
+bool TinyGsmPduDecode(const char* hex, size_t len, TinyGsmSmsPdu& sms)
+{
+  TinyGsmPduReader r(hex, len);
+  return TinyGsmPduDecode(r, sms);
+}
+
+#endif
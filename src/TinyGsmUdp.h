@@ -0,0 +1,336 @@
+/**
+ * @file       TinyGsmUdp.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Oct 2026
+ */
+
+#ifndef TinyGsmUdp_h
+#define TinyGsmUdp_h
+
+#include <TinyGsmCommon.h>
+#include <Udp.h>
+
+// Largest datagram that can be sent or received
+#if !defined(TINY_GSM_UDP_BUFFER)
+  #if defined(TINY_GSM_RX_BUFFER)
+    #define TINY_GSM_UDP_BUFFER TINY_GSM_RX_BUFFER
+  #else
+    #define TINY_GSM_UDP_BUFFER 64
+  #endif
+#endif
+
+/*
+ * Arduino UDP on a modem socket. beginPacket()/write() collect one
+ * datagram, endPacket() sends it with a single modem send command.
+ * parsePacket() fetches the next received datagram into a local buffer.
+ *
+ * The drivers implement modemSendTo() and modemReceive().
+ */
+class TinyGsmUdp : public UDP
+{
+public:
+  TinyGsmUdp() {
+    local_port = 0;
+    dest_port = 0;
+    dest_host[0] = '\0';
+    dest_changed = true;
+    tx_len = 0;
+    tx_ok = false;
+    rx_len = rx_pos = 0;
+    remote_port = 0;
+  }
+
+  virtual ~TinyGsmUdp() {}
+
+  virtual uint8_t begin(uint16_t port) {
+    local_port = port;
+    return 1;
+  }
+
+  virtual int beginPacket(IPAddress ip, uint16_t port) {
+    char host[16];
+    sprintf(host, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return beginPacket(host, port);
+  }
+
+  virtual int beginPacket(const char* host, uint16_t port) {
+    if (strlen(host) >= sizeof(dest_host)) {
+      return 0;
+    }
+    if (port != dest_port || strcmp(host, dest_host) != 0) {
+      strcpy(dest_host, host);
+      dest_port = port;
+      dest_changed = true;
+    }
+    tx_len = 0;
+    tx_ok = true;
+    return 1;
+  }
+
+  virtual size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  // Whatever doesn't fit into TINY_GSM_UDP_BUFFER makes endPacket() fail
+  virtual size_t write(const uint8_t* buf, size_t size) {
+    size_t n = TinyGsmMin(size, sizeof(tx_buf) - tx_len);
+    memcpy(tx_buf + tx_len, buf, n);
+    tx_len += n;
+    if (n < size) {
+      tx_ok = false;
+    }
+    return n;
+  }
+
+  virtual int endPacket() {
+    bool ok = tx_ok && modemSendTo(dest_host, dest_port, tx_buf, tx_len);
+    tx_len = 0;
+    tx_ok = false;
+    return ok;
+  }
+
+  // Returns the size of the next datagram, 0 if none is waiting
+  virtual int parsePacket() {
+    rx_pos = 0;
+    rx_len = modemReceive(rx_buf, sizeof(rx_buf));
+    return rx_len;
+  }
+
+  virtual int available() {
+    return rx_len - rx_pos;
+  }
+
+  virtual int read() {
+    return rx_pos < rx_len ? rx_buf[rx_pos++] : -1;
+  }
+
+  virtual int read(unsigned char* buf, size_t len) {
+    size_t n = TinyGsmMin(len, (size_t)(rx_len - rx_pos));
+    memcpy(buf, rx_buf + rx_pos, n);
+    rx_pos += n;
+    return n;
+  }
+
+  virtual int read(char* buf, size_t len) {
+    return read((unsigned char*)buf, len);
+  }
+
+  virtual int peek() {
+    return rx_pos < rx_len ? rx_buf[rx_pos] : -1;
+  }
+
+  // Drops the rest of the current datagram
+  virtual void flush() {
+    rx_pos = rx_len;
+  }
+
+  virtual IPAddress remoteIP() {
+    return remote_ip;
+  }
+
+  virtual uint16_t remotePort() {
+    return remote_port;
+  }
+
+  using Print::write;
+
+  // False if str is not a dotted IPv4 address (a host name)
+  static bool parseIp(const String& str, IPAddress& ip) {
+    int a, b, c, d;
+    if (sscanf(str.c_str(), "%d.%d.%d.%d", &a, &b, &c, &d) != 4) {
+      return false;
+    }
+    ip = IPAddress(a, b, c, d);
+    return true;
+  }
+
+protected:
+  // Sends one datagram
+  virtual bool modemSendTo(const char* host, uint16_t port,
+                           const uint8_t* buf, size_t len) = 0;
+
+  // Reads one datagram (or as much as fits), sets remote_ip/remote_port
+  virtual size_t modemReceive(uint8_t* buf, size_t len) = 0;
+
+  uint16_t      local_port;
+  uint16_t      dest_port;
+  char          dest_host[48];
+  bool          dest_changed;   // For drivers that bind the socket to one peer
+
+  uint8_t       tx_buf[TINY_GSM_UDP_BUFFER];
+  uint16_t      tx_len;
+  bool          tx_ok;
+
+  uint8_t       rx_buf[TINY_GSM_UDP_BUFFER];
+  uint16_t      rx_len;
+  uint16_t      rx_pos;
+  IPAddress     remote_ip;
+  uint16_t      remote_port;
+};
+
+/*
+ * GsmUdp of the modems that open UDP like a TCP connection, with
+ * CIPSTART "UDP" (SIM800, SIM7000). The modem binds the mux to a single
+ * peer, so it is reopened whenever beginPacket() names another one.
+ * Received data comes through CIPRXGET like on TCP, which does not keep
+ * datagram boundaries: parsePacket() returns whatever is buffered, up to
+ * TINY_GSM_UDP_BUFFER bytes, and remoteIP() is the current peer.
+ * The mux must not be one a GsmClient was created on.
+ *
+ * The modem provides sockets[], udps[], modemConnectUdp(), modemReadUdp()
+ * and modemSend(), and sets got_data from its +CIPRXGET URC.
+ */
+template <class Modem>
+class TinyGsmUdpConnected : public TinyGsmUdp
+{
+public:
+  bool init(Modem* modem, uint8_t mux = 2) {
+    this->at = modem;
+    this->mux = mux;
+    sock_opened = false;
+    got_data = false;
+
+    if (!muxFree()) {
+      return false;
+    }
+    at->udps[mux] = static_cast<typename Modem::GsmUdp*>(this);
+
+    return true;
+  }
+
+  virtual void stop() {
+    if (sock_opened) {
+      at->sendAT(GF("+CIPCLOSE="), mux, GF(",1"));  // Quick close
+      at->waitResponse();
+    }
+    sock_opened = false;
+    got_data = false;
+    rx_len = rx_pos = 0;
+  }
+
+protected:
+  virtual bool modemSendTo(const char* host, uint16_t port,
+                           const uint8_t* buf, size_t len) {
+    if (!sock_opened || dest_changed) {
+      stop();
+      if (!muxFree()) {
+        return false;
+      }
+      sock_opened = at->modemConnectUdp(host, port, local_port, mux);
+      if (!sock_opened) {
+        return false;
+      }
+      dest_changed = false;
+    }
+    return at->modemSend(buf, len, mux) == len;
+  }
+
+  virtual size_t modemReceive(uint8_t* buf, size_t len) {
+    if (!sock_opened) {
+      return 0;
+    }
+    if (!got_data) {
+      at->maintain();
+    }
+    if (!got_data) {
+      return 0;
+    }
+    size_t n = at->modemReadUdp(buf, len, mux);
+    if (n) {
+      parseIp(dest_host, remote_ip);
+      remote_port = dest_port;
+    }
+    return n;
+  }
+
+  // GsmClient and GsmUdp share the muxes, one can't take the other's
+  bool muxFree() {
+    if (at->sockets[mux]) {
+      DBG("### UDP mux", mux, "is used by a client");
+      return false;
+    }
+    return true;
+  }
+
+  Modem*        at;
+  uint8_t       mux;
+  bool          sock_opened;
+  bool          got_data;
+};
+
+/*
+ * GsmUdp of the u-blox modems, on a USOCR=17 socket (UBLOX, SARA-R4).
+ * Every endPacket() is one USOST, and every parsePacket() one USORF,
+ * which returns a single datagram along with the sender's address.
+ *
+ * The modem provides udps[], modemOpenUdp(), modemSendTo() and
+ * modemReadFrom(), and sets sock_available from its +UUSORF URC.
+ */
+template <class Modem>
+class TinyGsmUdpSocket : public TinyGsmUdp
+{
+public:
+  bool init(Modem* modem) {
+    this->at = modem;
+    this->mux = 0;
+    sock_available = 0;
+    sock_opened = false;
+    return true;
+  }
+
+  // Opens the socket bound to the given local port (0 for any)
+  virtual uint8_t begin(uint16_t port) {
+    stop();
+    local_port = port;
+    sock_opened = at->modemOpenUdp(port, &mux,
+                                   static_cast<typename Modem::GsmUdp*>(this));
+    return sock_opened;
+  }
+
+  virtual void stop() {
+    if (sock_opened) {
+      TINY_GSM_YIELD();
+      at->sendAT(GF("+USOCL="), mux);
+      at->waitResponse();
+      at->udps[mux] = NULL;
+    }
+    sock_opened = false;
+    sock_available = 0;
+    rx_len = rx_pos = 0;
+  }
+
+protected:
+  virtual bool modemSendTo(const char* host, uint16_t port,
+                           const uint8_t* buf, size_t len) {
+    if (!sock_opened && !begin(local_port)) {
+      return false;
+    }
+    return at->modemSendTo(host, port, buf, len, mux) == len;
+  }
+
+  virtual size_t modemReceive(uint8_t* buf, size_t len) {
+    if (!sock_opened) {
+      return 0;
+    }
+    if (!sock_available) {
+      at->maintain();
+    }
+    if (!sock_available) {
+      return 0;
+    }
+    String ip;
+    size_t n = at->modemReadFrom(buf, len, mux, ip, remote_port);
+    parseIp(ip, remote_ip);
+    sock_available = (n < sock_available) ? sock_available - n : 0;
+    return n;
+  }
+
+  Modem*        at;
+  uint8_t       mux;
+  uint16_t      sock_available;
+  bool          sock_opened;
+};
+
+#endif